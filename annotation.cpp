@@ -0,0 +1,244 @@
+/* annotation.cpp
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Member function definitions for Annotation class
+*/
+
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <map>
+using std::map;
+
+#include <utility>
+using std::make_pair;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "annotation.h"
+
+Annotation::Annotation(string n, Type t) {
+	name = n;
+	type = t;
+}
+
+string Annotation::getName() {
+	return name;
+}
+
+Annotation::Type Annotation::getType() {
+	return type;
+}
+
+bool Annotation::has(int row) {
+	return row >= 0 && row < present.size() && present[row];
+}
+
+void Annotation::set(int row, string value) {
+
+	grow(row);
+
+	/* a column that turns out not to be numeric keeps its numbers as text */
+	if (type == NUMERIC && classify(value) != NUMERIC) {
+		type = CATEGORICAL;
+		codes.assign(present.size(), -1);
+		for (int r = 0; r < present.size(); r++) {
+			if (present[r]) {
+				string number = "";
+				appendNumber(number, numbers[r]);
+				present[r] = 0;
+				set(r, number);
+			}
+		}
+		numbers.clear();
+	}
+
+	if (type == NUMERIC) {
+		numbers[row] = atof(text(value).c_str());
+	}
+	
+	if (type == CATEGORICAL) {
+		string category = text(value);
+		map<string,int>::iterator ic = categoryIndex.find(category);
+		if (ic == categoryIndex.end()) {
+			ic = categoryIndex.insert(make_pair(category, (int) categories.size())).first;
+			categories.push_back(category);
+		}
+		codes[row] = (*ic).second;
+	}
+	
+	if (type == VECTOR) {
+		vector<double> v;
+		elements(value, v);
+		starts[row] = values.size();
+		sizes[row] = v.size();
+		values.insert(values.end(), v.begin(), v.end());
+	}
+	
+	present[row] = 1;
+
+}
+
+void Annotation::grow(int row) {
+	if (row >= present.size()) {
+		present.resize(row + 1, 0);
+		if (type == NUMERIC) { numbers.resize(row + 1, 0.0); }
+		if (type == CATEGORICAL) { codes.resize(row + 1, -1); }
+		if (type == VECTOR) { 
+			starts.resize(row + 1, 0); 
+			sizes.resize(row + 1, 0); 
+		}
+	}
+}
+
+void Annotation::append(string &out, int row) {
+
+	out += name;
+	out += '=';
+	if (type == NUMERIC) {
+		appendNumber(out, numbers[row]);
+	}
+	if (type == CATEGORICAL) {
+		out += '"';
+		out += categories[codes[row]];
+		out += '"';
+	}
+	if (type == VECTOR) {
+		out += '{';
+		for (int k = 0; k < sizes[row]; k++) {
+			if (k > 0) { out += ','; }
+			appendNumber(out, values[starts[row] + k]);
+		}
+		out += '}';
+	}
+
+}
+
+void Annotation::appendNumber(string &out, double n) {
+	char buffer[32];
+	int length = snprintf(buffer, sizeof(buffer), "%.10g", n);
+	out.append(buffer, length);
+}
+
+/* braces make a vector, quotes make a category, and anything else is numeric if it reads as a number */
+Annotation::Type Annotation::classify(string value) {
+
+	string::iterator is = value.begin();
+	while (is != value.end() && *is == ' ') { ++is; }
+	
+	if (is != value.end() && *is == '{') { return VECTOR; }
+	if (is != value.end() && *is == '"') { return CATEGORICAL; }
+	
+	string t = text(value);
+	if (t.size() == 0) { return CATEGORICAL; }
+	char *end;
+	strtod(t.c_str(), &end);
+	if (*end != '\0') { return CATEGORICAL; }
+	
+	return NUMERIC;
+	
+}
+
+string Annotation::text(string value) {
+	string t = "";
+	for (string::iterator is = value.begin(); is != value.end(); ++is) {
+		if (*is != '"' && *is != '{' && *is != '}') {
+			t += *is;
+		}
+	}
+	return t;
+}
+
+/* elements are separated by commas or spaces */
+void Annotation::elements(string value, vector<double> &v) {
+	v.clear();
+	string element = "";
+	for (string::iterator is = value.begin(); is != value.end(); ++is) {
+		if (*is == ',' || *is == ' ') {
+			if (element.size() > 0) { v.push_back(atof(element.c_str())); }
+			element = "";
+		}
+		else if (*is != '"' && *is != '{' && *is != '}') {
+			element += *is;
+		}
+	}
+	if (element.size() > 0) { v.push_back(atof(element.c_str())); }
+}
+
+/* labels come from states, location, cluster and Compartment, traits from antigenic, AHT and AHTL, the 
+sign of the third value of AHTL gives a north or south label, and single values fill x or y */
+map<string,int> Annotation::defaultRoles() {
+
+	map<string,int> roles;
+	roles["states"] = LABEL;
+	roles["location"] = LABEL;
+	roles["cluster"] = LABEL;
+	roles["Compartment"] = LABEL;
+	roles["antigenic"] = TRAIT;
+	roles["AHT"] = TRAIT;
+	roles["AHTL"] = HEMISPHERE | TRAIT;
+	roles["N"] = X;
+	roles["S"] = Y;
+	roles["layout"] = X;
+	roles["iSNV"] = X;
+	roles["latitude"] = X;
+	roles["diffusion"] = X;
+	roles["diffTrait"] = X;
+	roles["AC14_R"] = Y;
+	roles["rate"] = RATE;
+	return roles;
+
+}
+
+int Annotation::parseRole(string role) {
+	if (role == "label") { return LABEL; }
+	if (role == "x") { return X; }
+	if (role == "y") { return Y; }
+	if (role == "trait") { return TRAIT; }
+	if (role == "rate") { return RATE; }
+	if (role == "hemisphere") { return HEMISPHERE; }
+	if (role == "keep") { return KEEP; }
+	if (role == "discrete") { return DISCRETE; }
+	if (role == "ignore") { return 0; }
+	return -1;
+}
+
+string Annotation::describe(Type t, int roles) {
+
+	string s = "";
+	if (t == NUMERIC) { s = "numeric"; }
+	if (t == CATEGORICAL) { s = "categorical"; }
+	if (t == VECTOR) { s = "vector"; }
+	
+	if (roles == 0) { s += ", unused"; }
+	if (roles & LABEL) { s += ", label"; }
+	if (roles & HEMISPHERE) { s += ", hemisphere label"; }
+	if (roles & X) { s += ", x"; }
+	if (roles & Y) { s += ", y"; }
+	if (roles & TRAIT) { s += ", trait"; }
+	if (roles & RATE) { s += ", rate"; }
+	if (roles & DISCRETE) { s += ", discrete trait"; }
+	if (roles & KEEP) { s += ", kept"; }
+	return s;
+	
+}
@@ -0,0 +1,82 @@
+/* annotation.h
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Annotation class definition
+This object holds one column of [&key=value] annotations read from in.trees, typed as numeric, categorical
+or vector from its first value.  Rows are the numbers nodes were given when the tree was read.  Columns
+are only held for annotations that in.param asks to keep; the rest are consumed by the roles they are
+mapped to, which place them in the label, trait or rate of each node.
+*/
+
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ANNOT_H
+#define ANNOT_H
+
+#include <map>
+using std::map;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+class Annotation {
+
+public:
+	enum Type { NUMERIC, CATEGORICAL, VECTOR };
+	enum Role { LABEL = 1, X = 2, Y = 4, TRAIT = 8, RATE = 16, HEMISPHERE = 32, KEEP = 64, DISCRETE = 128 };
+											// roles are combined as bits, 0 ignores an annotation
+
+	Annotation(string,Type);				// constructor, empty column with name and type
+
+	string getName();
+	Type getType();
+	bool has(int);							// does row hold a value
+	void set(int,string);					// stores value as written, a numeric column holding a value
+											// that is not a number becomes categorical
+	void append(string &,int);				// appends key=value for row, as written in annotated NEWICK
+
+	// VALUES AS WRITTEN
+	static Type classify(string);			// type of value
+	static string text(string);				// value without quotes or braces
+	static void elements(string,vector<double> &);	// numbers in value, one for each element of a vector
+
+	// ROLES
+	static map<string,int> defaultRoles();	// roles of the annotations that were always read
+	static int parseRole(string);			// role named in in.param, -1 if unknown
+	static string describe(Type,int);		// type and roles in words
+
+private:
+	string name;
+	Type type;
+	vector<char> present;					// one per row
+	vector<double> numbers;					// NUMERIC, one per row
+	vector<int> codes;						// CATEGORICAL, one per row, into categories
+	vector<string> categories;
+	map<string,int> categoryIndex;
+	vector<int> starts;						// VECTOR, one per row, into elements
+	vector<int> sizes;
+	vector<double> values;					// elements of every row, in the order rows were set
+
+	void grow(int);							// makes room for row
+	void appendNumber(string &,double);
+
+};
+
+#endif
@@ -22,6 +22,8 @@ You should have received a copy of the GNU General Public License along with PAC
 #include <sstream>
 #include <fstream>
 using std::ofstream;
+using std::ifstream;
+using std::ostream;
 using std::stringstream;
 using std::cout;
 using std::endl;
@@ -32,6 +34,9 @@ using std::fixed;
 #include <string>
 using std::string;
 
+#include <map>
+using std::map;
+
 #include <set>
 using std::set;
 
@@ -46,6 +51,9 @@ using std::out_of_range;
 using std::atof;
 using std::atoi;
 
+#include <cstdio>
+using std::snprintf;
+
 #include <cmath>
 using std::sqrt;
 using std::pow;
@@ -57,165 +65,238 @@ using std::atan2;
 #include "node.h"
 #include "tree.hh"
 #include "series.h"
+#include "mask.h"
+#include "scanner.h"
+#include "splitter.h"
 
 /* Constructor function to initialize private data */
-/* Takes NEWICK parentheses tree as string input */
-CoalescentTree::CoalescentTree(string paren) {
+/* Takes NEWICK parentheses tree as characters from a scanner */
+CoalescentTree::CoalescentTree(Scanner &paren, map<string,int> &roles, vector<string> &discreteKeys) {
 
-	string::iterator is;
-	tree<Node>:: iterator it, jt;
+	start(discreteKeys.size());
+	parse(paren, roles, discreteKeys, NULL, NULL);
+	settle();
+
+}
+
+/* parts are read from their own streams, and errors are raised once all have finished */
+/* parts are grafted as the rest of the tree is read in order, so that node numbers, label sets and the 
+   types and columns of annotations come out as a single reading would leave them */
+CoalescentTree::CoalescentTree(Splitter &split, map<string,int> &roles, vector<string> &discreteKeys) {
+
+	start(discreteKeys.size());
 	
-	// make sure that parentheses are matched, counting '(' and counting ')'
-	int leftcount = 0;
-	int rightcount = 0;
-	for ( is=paren.begin(); is < paren.end(); ++is ) {
-		if (*is == '(') { leftcount++; }
-		if (*is == ')') { rightcount++; }
+	vector<CoalescentTree> parts (split.size(), *this);
+	vector<string> errors (split.size());
+	#pragma omp parallel for schedule(dynamic)
+	for (int k = 0; k < split.size(); k++) {
+		try {
+			ifstream inStream;
+			inStream.open(split.getFile().c_str(), ios::in | ios::binary);
+			inStream.seekg(split.getOffset() + split.getStart(k));
+			Scanner scanner (inStream, split.getLength(k));
+			parts[k].part = true;
+			parts[k].parse(scanner, roles, discreteKeys, NULL, NULL);
+		}
+		catch (runtime_error &e) {
+			errors[k] = e.what();
+		}
 	}
-	if (leftcount != rightcount) {
-		throw runtime_error("unmatched parentheses in in.trees");
+	for (int k = 0; k < split.size(); k++) {
+		if (errors[k].size() > 0) {
+			throw runtime_error(errors[k]);
+		}
 	}
+	
+	ifstream inStream;
+	inStream.open(split.getFile().c_str(), ios::in | ios::binary);
+	inStream.seekg(split.getOffset());
+	Scanner scanner (inStream, split.getLength());
+	parse(scanner, roles, discreteKeys, &split, &parts);
+	settle();
+
+}
 
-	// STARTING TREE /////////////////
+void CoalescentTree::start(int discretes) {
+
+	aggregated = false;
+	dimensions = 2;
+	discrete = 0;
+	discreteSets.resize(discretes);
+	part = false;
+	
 	// starting point as single root node
 	Node rootNode = Node(0);
-	it = nodetree.set_head(rootNode);
+	rootNode.setRow(0);
+	nodetree.set_head(rootNode);
+
+}
+
+/* subtrees parsed apart begin at a '(', which ends any name or length before it, and end at the matching ')', 
+   after which the node is where that ')' would leave it */
+void CoalescentTree::parse(Scanner &paren, map<string,int> &roles, vector<string> &discreteKeys, 
+	Splitter *split, vector<CoalescentTree> *parts) {
+
+	tree<Node>::iterator it = nodetree.begin();
 	
 	// WALK THROUGH NEWICK STRING ////
 	// collect a substring, stop at ( ) , :
+	// characters are read once, in order, so parentheses are matched as they are met
 	
 	string nameOrLength = "";
-	string bracketed = "";
 	int nodeCount = 1;
 	bool lengthCheck = false;
-	bool bracketCheck = false;
-	bool braceCheck = false;
+	int depth = 0;
+	int next = 0;							// next part to graft
 	
 	// fill 'nameOrLength' with names and branch lengths
-	// 'bracketed' placeholder for bracketed strings
-	for (is = paren.begin(); is < paren.end(); ++is ) {
+	while (paren.more()) {
+	
+		bool apart = split != NULL && next < split->size() && paren.position() == split->getStart(next);
+		char c = paren.get();
 									
 		// OUTSIDE OF BRACKETS
 		// branch tree, update names, updates branch lengths
-		if (!bracketCheck) {
 		
-			// filling nameOrLength
-			if ( (*is >= '0' && *is <= '9') || (*is >= 'A' && *is <= 'Z') || (*is >= 'a' && *is <= 'z') || *is == '.' || *is == '-' || *is == '_' || *is == '/' || *is == '|' ) {
-				nameOrLength += *is;
-			}	
+		// filling nameOrLength
+		if ( (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '.' || c == '-' || c == '_' || c == '/' || c == '|' ) {
+			nameOrLength += c;
+		}	
 		
-			// : --> name node, keep pointer where it is, prime loop to update a length, set as tip
-			if (*is == ':') {
-			
-				if (nameOrLength.length() > 0) {
-					(*it).setName(nameOrLength);
-					(*it).setLeaf(true);
-					(*it).setLabel(initialDigits(nameOrLength));
-					if(initialDigits(nameOrLength) != "0") {
-						labelset.insert(initialDigits(nameOrLength));
-					}
-					nameOrLength = "";
-				}
-				
-				lengthCheck = true;
-				
-			}	
-							
-			if ( (*is == '[' || *is == '(' || *is == ')' || *is == ',') && nameOrLength.length() > 0) {
-			
-				//  update node length, if lengthCheck is flagged
-				if (lengthCheck) {
-					(*it).setLength(atof(nameOrLength.c_str()));
-					lengthCheck = false;			
-				}
-				
-				//  update node name, assuming branch lengths are absent, set as tip
-				else {
-					(*it).setName(nameOrLength);
-					(*it).setLeaf(true);
-					(*it).setLabel(initialDigits(nameOrLength));
-					if(initialDigits(nameOrLength) != "0") {
-						labelset.insert(initialDigits(nameOrLength));
-					}
+		// : --> name node, keep pointer where it is, prime loop to update a length, set as tip
+		if (c == ':') {
+		
+			if (nameOrLength.length() > 0) {
+				(*it).setName(nameOrLength);
+				(*it).setLeaf(true);
+				(*it).setLabel(initialDigits(nameOrLength));
+				if(initialDigits(nameOrLength) != "0") {
+					labelset.insert(initialDigits(nameOrLength));
 				}
-				
 				nameOrLength = "";
-				
-			}			
+			}
+			
+			lengthCheck = true;
 			
-			// ( --> add child node, move pointer to this child node
-			if (*is == '(') {
-				Node thisNode(nodeCount);
-				it = nodetree.append_child(it,thisNode);
-				nodeCount++;
+		}	
+						
+		if ( (c == '[' || c == '(' || c == ')' || c == ',') && nameOrLength.length() > 0) {
+		
+			//  update node length, if lengthCheck is flagged
+			if (lengthCheck) {
+				(*it).setLength(atof(nameOrLength.c_str()));
+				lengthCheck = false;			
 			}
-	
-			// , --> add sister node, move pointer to this sister node
-			if (*is == ',') {
-				Node thisNode(nodeCount);
-				it = nodetree.insert_after(it,thisNode);
-				nodeCount++;
+			
+			//  update node name, assuming branch lengths are absent, set as tip
+			else {
+				(*it).setName(nameOrLength);
+				(*it).setLeaf(true);
+				(*it).setLabel(initialDigits(nameOrLength));
+				if(initialDigits(nameOrLength) != "0") {
+					labelset.insert(initialDigits(nameOrLength));
+				}
 			}
 			
-			// ) --> move pointer to parent node, need to inherit state when moving up the tree
-			if (*is == ')') {
-				string childLabel = (*it).getLabel();
-				it = nodetree.parent(it);
-				(*it).setLabel(childLabel);
-			}		
+			nameOrLength = "";
+			
+		}
 		
+		// subtree parsed apart --> graft its nodes, move past it
+		if (apart) {
+			paren.skip(split->getLength(next) - 1);
+			nodeCount += graft(it, (*parts)[next], nodeCount - 1);
+			lengthCheck = false;
+			next++;
+			continue;
 		}
 		
-		// prime bracketed
-		if (*is == '[') { 
-			bracketCheck = true; 
-			bracketed = "";
+		// ( --> add child node, move pointer to this child node
+		if (c == '(') {
+			depth++;
+			Node thisNode(nodeCount);
+			thisNode.setRow(nodeCount);
+			it = nodetree.append_child(it,thisNode);
+			nodeCount++;
+		}
+	
+		// , --> add sister node, move pointer to this sister node
+		if (c == ',') {
+			Node thisNode(nodeCount);
+			thisNode.setRow(nodeCount);
+			it = nodetree.insert_after(it,thisNode);
+			nodeCount++;
+		}
+		
+		// ) --> move pointer to parent node, need to inherit state when moving up the tree
+		if (c == ')') {
+			depth--;
+			if (depth < 0) {
+				throw runtime_error("unmatched parentheses in in.trees");
+			}
+			string childLabel = (*it).getLabel();
+			vector<string> childDiscretes = (*it).getDiscretes();
+			it = nodetree.parent(it);
+			(*it).setLabel(childLabel);
+			(*it).setDiscretes(childDiscretes);
 		}		
 		
 		// INSIDE OF BRACKETS
 		// update labels, add migration events
-		if (bracketCheck) {
-		
-			// fill bracketed
-			if (bracketCheck && *is != '[' && *is != ']') {
-				bracketed += *is;
-			}
-
-			if (*is == '{') { braceCheck = true; }
-			if (*is == '}') { braceCheck = false; }			
-			
+		// entries are read in place, and entries whose key has no role are passed over by searching only 
+		// for the characters that can end them
+		if (c == '[') {
 		
-			if (*is == ']' || (*is == ',' && braceCheck == false)) {
-			
-	//			cout << bracketed << endl;
+			while (paren.more() && paren.peek() != ']') {
 			
-				// fill 4 strings delimited by ' ', ':' and '=' 
-				string::iterator ib;	
-				string stringOne = "";
-				string stringTwo = "";
-				string stringThree = "";
-				string stringFour = "";
-				int counter = 1;
-				
-				ib = bracketed.begin();
-				while (ib != bracketed.end()) {
-					if (*ib != '&' && *ib != '{' && *ib != '}' && *ib != '"') {		// ignore these completely
-						if (*ib != ' ' && *ib != '=' && *ib != ':' && *ib != ',') {				// ignore these and increment counter
-							if (counter == 1) { stringOne += *ib; }
-							if (counter == 2) { stringTwo += *ib; }
-							if (counter == 3) { stringThree += *ib; }
-							if (counter == 4) { stringFour += *ib; }
-						}
-						else {
-							++counter;
-						}
+				// key runs up to the first ' ', ':', '=' or ','
+				string key = "";
+				while (paren.more()) {
+					char k = paren.peek();
+					if (k == ' ' || k == '=' || k == ':' || k == ',' || k == ']') {
+						break;
 					}
-				++ib;
+					if (k != '&' && k != '{' && k != '}' && k != '"') {		// ignore these completely
+						key += k;
+					}
+					paren.get();
+				}
+				if (paren.more() && paren.peek() != ',' && paren.peek() != ']') {
+					paren.get();
 				}
 				
+				// value runs up to the next ',' outside of braces, or to the closing ']'
+				// it is only copied out where it is read
+				map<string,int>::iterator ir = roles.find(key);
+				bool typed = annotationTypes.find(key) != annotationTypes.end();
+				bool used = ir != roles.end() && (*ir).second != 0;
+				string value = "";
+				paren.readEntry(value, key == "M" || (key.size() > 0 && (!typed || used)));
+				
 				// MIGRATION
 				// insert an additional node up the tree
-				if (stringOne == "M") {
+				if (key == "M") {
+				
+					string::iterator ib;
+					
+					// fill 3 strings delimited by ' ', ':', '=' and ','
+					string stringTwo = "";
+					string stringThree = "";
+					string stringFour = "";
+					int counter = 2;
+					
+					for (ib = value.begin(); ib != value.end(); ++ib) {
+						if (*ib != '&' && *ib != '{' && *ib != '}' && *ib != '"') {
+							if (*ib != ' ' && *ib != '=' && *ib != ':' && *ib != ',') {
+								if (counter == 2) { stringTwo += *ib; }
+								if (counter == 3) { stringThree += *ib; }
+								if (counter == 4) { stringFour += *ib; }
+							}
+							else {
+								++counter;
+							}
+						}
+					}
 				
 					int fromInt = atoi(stringTwo.c_str()) + 1;
 					int toInt = atoi(stringThree.c_str()) + 1;
@@ -237,6 +318,7 @@ CoalescentTree::CoalescentTree(string paren) {
 					Node migNode(nodeCount);
 					migNode.setLabel(from);
 					labelset.insert(from);
+					migNode.setDiscretes((*it).getDiscretes());
 					migNode.setLength(newLength);
 					nodeCount++;
 					
@@ -245,127 +327,94 @@ CoalescentTree::CoalescentTree(string paren) {
 					
 				}
 				
-				// STATE / LABEL
-				// label current node
-				if (stringOne == "states") {
-					string loc = stringTwo.c_str();
-					(*it).setLabel(loc);
-					labelset.insert(loc);		
-				}
-				
-				if (stringOne == "location") {
-					string loc = stringTwo.c_str();
-					(*it).setLabel(loc);
-					labelset.insert(loc);		
-				}	
-				
-				if (stringOne == "cluster") {
-					string loc = stringTwo.c_str();
-					(*it).setLabel(loc);
-					labelset.insert(loc);		
-				}					
-				
-				if (stringOne == "Compartment") {
-					string loc = stringTwo.c_str();
-					(*it).setLabel(loc);
-					labelset.insert(loc);		
-				}								
-				
-				// ANTIGENIC
-				if (stringOne == "antigenic") {
-					double xloc = atof(stringTwo.c_str());
-					double yloc = atof(stringThree.c_str());
-					(*it).setX(xloc);
-					(*it).setY(yloc);					
-				}	
-				
-				// NONSYNONYMOUS
-				if (stringOne == "N") {
-					double xloc = atof(stringTwo.c_str());
-					(*it).setX(xloc);
-				}
-				
-				// SYNONYMOUS
-				if (stringOne == "S") {
-					double yloc = atof(stringTwo.c_str());
-					(*it).setY(yloc);
-				}				
-				
-				// LAYOUT
-				if (stringOne == "layout") {
-					double xloc = atof(stringTwo.c_str());
-					(*it).setX(xloc);				
-				}	
-				
-				// iSNV
-				if (stringOne == "iSNV") {
-					double xloc = atof(stringTwo.c_str());
-					(*it).setX(xloc);				
-				}					
-				
-				// LATITUDE
-				if (stringOne == "latitude") {
-					double xloc = atof(stringTwo.c_str());
-					(*it).setX(xloc);				
-				}									
+				// ANNOTATION
+				// typed on first appearance in this tree, and passed on to the roles its key is mapped to
+				else if (key.size() > 0) {
 				
-				// DIFFUSION
-				if (stringOne == "diffusion") {
-					double xloc = atof(stringTwo.c_str());
-					(*it).setX(xloc);				
-				}	
-				if (stringOne == "diffTrait") {
-					double xloc = atof(stringTwo.c_str());
-					(*it).setX(xloc);				
-				}					
-	
-				// AHT
-				if (stringOne == "AHT") {
-					double xloc = atof(stringTwo.c_str());
-					double yloc = atof(stringThree.c_str());
-					(*it).setX(xloc);
-					(*it).setY(yloc);					
-				}	
-				
-				// ACX_R
-				if (stringOne == "AC14_R") {
-					double yloc = atof(stringTwo.c_str());
-					(*it).setY(yloc);				
-				}				
-				
-				// AHTL
-				if (stringOne == "AHTL") {
-					double xloc = atof(stringTwo.c_str());
-					double yloc = atof(stringThree.c_str());
-					double z = atof(stringFour.c_str());
-					if (z < 0) {
-						(*it).setLabel("south");
-					} else {
-						(*it).setLabel("north");
+					if (!typed) {
+						annotationTypes[key] = Annotation::classify(value);
 					}
-					(*it).setX(xloc);
-					(*it).setY(yloc);					
-				}					
-				
-				// RATE
-				if (stringOne == "rate") {
-					double rate = atof(stringTwo.c_str());
-					(*it).setRate(rate);
-				}				
-				
-				
-				bracketed = "";
+					
+					if (used) {
+						int d = 0;
+						if ((*ir).second & Annotation::DISCRETE) {
+							while (d < discreteKeys.size() && discreteKeys[d] != key) { d++; }
+							d++;
+						}
+						annotate(it, key, value, (*ir).second, d);
+					}
+					
+				}
 				
-				if (*is == ']') { 
-					bracketCheck = false;
+				if (paren.more() && paren.peek() == ',') {
+					paren.get();
 				}
 				
 			}
-		
+			
 		}
 			
 	}
 	
+	if (depth != 0) {
+		throw runtime_error("unmatched parentheses in in.trees");
+	}
+
+}
+
+/* the part's own root stands for the node, which takes the label its ')' would have passed up */
+int CoalescentTree::graft(tree<Node>::iterator it, CoalescentTree &p, int offset) {
+
+	tree<Node>::iterator top = p.nodetree.begin();
+	
+	int moved = 0;
+	for (tree<Node>::iterator jt = p.nodetree.begin(); jt != p.nodetree.end(); ++jt) {
+		if (jt != top) {
+			(*jt).setNumber((*jt).getNumber() + offset);
+			if ((*jt).getRow() >= 0) {
+				(*jt).setRow((*jt).getRow() + offset);
+			}
+			moved++;
+		}
+	}
+	nodetree.reparent(it, top);
+	(*it).setLabel((*top).getLabel());
+	(*it).setDiscretes((*top).getDiscretes());
+	
+	labelset.insert(p.labelset.begin(), p.labelset.end());
+	for (int d = 0; d < discreteSets.size(); d++) {
+		discreteSets[d].insert(p.discreteSets[d].begin(), p.discreteSets[d].end());
+	}
+	if (p.dimensions > dimensions) {
+		dimensions = p.dimensions;
+	}
+	annotationTypes.insert(p.annotationTypes.begin(), p.annotationTypes.end());
+	
+	// kept values are set in the order they were read, as columns change type and gather categories
+	vector<int> columns (p.keptKeys.size(), -1);
+	int begin = 0;
+	for (int j = 0; j < p.keptRows.size(); j++) {
+		int k = p.keptKeyIndex[j];
+		if (columns[k] < 0) {
+			int a = 0;
+			while (a < annotations.size() && annotations[a].getName() != p.keptKeys[k]) { a++; }
+			if (a == annotations.size()) {
+				annotations.push_back(Annotation(p.keptKeys[k], annotationTypes[p.keptKeys[k]]));
+			}
+			columns[k] = a;
+		}
+		annotations[columns[k]].set(p.keptRows[j] + offset, p.keptText.substr(begin, p.keptEnds[j] - begin));
+		begin = p.keptEnds[j];
+	}
+	
+	return moved;
+
+}
+
+void CoalescentTree::settle() {
+
+	tree<Node>::iterator it, jt;
+	
 	// adding branch length to the parent node's time to get the node's time
 	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
 		jt = nodetree.parent(it);
@@ -383,7 +432,87 @@ CoalescentTree::CoalescentTree(string paren) {
 	
 	/* pushing the most recent sample up to time = 0 */
 	pushTimesBack(0);
-			
+
+}
+
+/* passes value of annotation to every role its key is mapped to, and keeps it if asked */
+void CoalescentTree::annotate(tree<Node>::iterator it, string key, string value, int roles, int d) {
+
+	// LABEL
+	if (roles & Annotation::LABEL) {
+		string loc = Annotation::text(value);
+		(*it).setLabel(loc);
+		labelset.insert(loc);
+	}
+	
+	// FURTHER DISCRETE TRAIT
+	if (roles & Annotation::DISCRETE && d <= discreteSets.size()) {
+		string loc = Annotation::text(value);
+		(*it).setDiscrete(d, loc);
+		discreteSets[d-1].insert(loc);
+	}
+	
+	vector<double> v;
+	if (roles & (Annotation::HEMISPHERE | Annotation::X | Annotation::Y | Annotation::TRAIT | Annotation::RATE)) {
+		Annotation::elements(value, v);
+	}
+	double first = 0.0;
+	if (v.size() > 0) { first = v[0]; }
+	
+	// HEMISPHERE
+	// sign of third value, as with AHTL
+	if (roles & Annotation::HEMISPHERE) {
+		double z = 0.0;
+		if (v.size() > 2) { z = v[2]; }
+		if (z < 0) {
+			(*it).setLabel("south");
+		} else {
+			(*it).setLabel("north");
+		}
+	}
+	
+	// LOCATION AND RATE
+	if (roles & Annotation::X) { (*it).setX(first); }
+	if (roles & Annotation::Y) { (*it).setY(first); }
+	if (roles & Annotation::TRAIT) { setTraits(it, v); }
+	if (roles & Annotation::RATE) { (*it).setRate(first); }
+	
+	// KEPT COLUMN
+	// migration nodes added while reading have no row
+	if (roles & Annotation::KEEP && (*it).getRow() >= 0 && part) {
+		int k = 0;
+		while (k < keptKeys.size() && keptKeys[k] != key) { k++; }
+		if (k == keptKeys.size()) {
+			keptKeys.push_back(key);
+		}
+		keptRows.push_back((*it).getRow());
+		keptKeyIndex.push_back(k);
+		keptText += value;
+		keptEnds.push_back(keptText.size());
+	}
+	else if (roles & Annotation::KEEP && (*it).getRow() >= 0) {
+		int a = 0;
+		while (a < annotations.size() && annotations[a].getName() != key) { a++; }
+		if (a == annotations.size()) {
+			annotations.push_back(Annotation(key, annotationTypes[key]));
+		}
+		annotations[a].set((*it).getRow(), value);
+	}
+
+}
+
+/* sets x and y from the first two values, and dimensions beyond them from the rest */
+void CoalescentTree::setTraits(tree<Node>::iterator it, vector<double> &v) {
+
+	(*it).setX(0.0);
+	(*it).setY(0.0);
+	for (int k = 0; k < v.size(); k++) {
+		(*it).setTrait(k, v[k]);
+	}
+	if ((*it).getDimensions() > dimensions) {
+		dimensions = (*it).getDimensions();
+	}
+
 }
 
 /* return initial digits in a string, incremented by 1, return 0 on failure 34ATZ -> 35, 3454 -> 0 */
@@ -429,8 +558,10 @@ void CoalescentTree::pushTimesBack(double endTime) {
 	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it) {
 		double t = (*it).getTime();
 		(*it).setTime(t + diff);
-	}	
-		  	
+	}
+
+	modified();
+
 }
 
 /* push dates to agree with a most recent sample date at endTime and oldest sample date is startTime */
@@ -468,6 +599,7 @@ void CoalescentTree::pushTimesBack(double startTime, double endTime) {
 				(*it).setTime(t);
 			}
 		}	
+		modified();
 	
 	}
 
@@ -479,71 +611,49 @@ void CoalescentTree::pushTimesBack(double startTime, double endTime) {
 	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it) {
 		double t = (*it).getTime();
 		(*it).setTime(t + diff);
-	}		
-		 
+	}
+
+	modified();
+
 }
 
 /* old version of renewTrunk.  This peels back from all current nodes. */
 void CoalescentTree::renewTrunk(double t) {
 
-	/* go through tree and append to trunk set */
+	/* nodes at present are marked as trunk, and marks are passed up to parents in a single */
+	/* sweep back through preorder */
 	double presentTime = getPresentTime();
-	tree<Node>::iterator it, jt;
+	vector<tree<Node>::iterator> nodes;
+	vector<int> parents;
+	flatten(nodes, parents);
 	
-	for(it = nodetree.begin(); it != nodetree.end(); ++it) {
-		(*it).setTrunk(false);
+	vector<char> trunk (nodes.size(), false);
+	for (int i = nodes.size() - 1; i >= 0; i--) {
+		if ((*nodes[i]).getTime() > presentTime - t) {
+			trunk[i] = true;
+		}
+		if (trunk[i] && parents[i] >= 0) {
+			trunk[parents[i]] = true;
+		}
 	}
+	trunk[0] = true;
 	
-	it = nodetree.begin();
-	(*it).setTrunk(true);
-	while(it != nodetree.end()) {
-		/* find nodes at present */
-		if ((*it).getTime() > presentTime - t) {
-			jt = it;
-			/* move up tree adding nodes to trunk set */
-			while (nodetree.is_valid(jt)) {
-				(*jt).setTrunk(true);
-				jt = nodetree.parent(jt);
-			}
-		}
-		++it;
-	}	
-}				
+	for (int i = 0; i < nodes.size(); i++) {
+		(*nodes[i]).setTrunk(trunk[i]);
+	}
+
+	modified();
+
+}
 
 
 /* reduces a tree to a random subset of samples */
 void CoalescentTree::reduceTips(double pro) {
 
-	/* start by finding all tips with this label */
-	set<int> tipset; 
-	tree<Node>::iterator it, jt;
-	
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		if ( rgen.uniform(0,1) < pro && (*it).getLeaf() ) {
-		
-			/* move up tree adding nodes to label set */
-			jt = it;
-			while (nodetree.is_valid(jt)) {
-				tipset.insert( (*jt).getNumber() );
-				jt = nodetree.parent(jt);
-			}
-		
-		}
-	}
-			
-	/* erase other nodes from the tree */
-	it = nodetree.begin();
-	while(it != nodetree.end()) {
-		if (tipset.end() == tipset.find( (*it).getNumber() )) {
-			it = nodetree.erase(it);
-		}
-		else {
-    		++it;
-    	}
-    }
-        
+	eraseUnmasked( getRandomMask(pro) );
    	peelBack();     
 	reduce();
+	modified();
 				
 }
 
@@ -583,27 +693,16 @@ void CoalescentTree::renewTrunkRandom(double t) {
 			count++;
 		}
 		++it;
-	}	
-	
+	}
+
+	modified();
+
 }
 
 /* reduces a tree to just its trunk, takes most recent sample and works backward from this */
 void CoalescentTree::pruneToTrunk() {
 	
-	/* erase other nodes from the tree */	
-	tree<Node>::iterator it;
-	it = nodetree.begin();
-	while(it != nodetree.end()) {
-		if ( !(*it).getTrunk() ) {
-			it = nodetree.erase(it);
-		}
-		else {
-    		++it;
-    	}
-    }
-            
-//	peelBack();            
-	reduce();
+	pruneToMask( getTrunkMask() );
 			
 }
 
@@ -611,171 +710,174 @@ void CoalescentTree::pruneToTrunk() {
 /* reduces a tree to samples with a single label */
 void CoalescentTree::pruneToLabel(string label) {
 
-	/* start by finding all tips with this label */
-	set<int> nodeset; 
-	tree<Node>::iterator it, jt;
-	
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		if ( (*it).getLabel() == label && (*it).getLeaf() ) {
-		
-			/* move up tree adding nodes to label set */
-			jt = it;
-			while (nodetree.is_valid(jt)) {
-				nodeset.insert( (*jt).getNumber() );
-				jt = nodetree.parent(jt);
-			}
-		
-		}
-	}
-			
-	/* erase other nodes from the tree */
-	it = nodetree.begin();
-	while(it != nodetree.end()) {
-		if (nodeset.end() == nodeset.find( (*it).getNumber() )) {
-			it = nodetree.erase(it);
-		}
-		else {
-    		++it;
-    	}
-    }
-        
-//	peelBack();     
-	reduce();
+	pruneToMask( getLabelMask(label) );
 				
 }
 
 /* reduces a tree to specified set of tips */
 void CoalescentTree::pruneToTips(vector<string> tipsToInclude) {
 
-	/* start by finding all tips in the set */
-	set<int> nodeset; 
-	tree<Node>::iterator it, jt;
-	
-  	for (int i = 0; i < tipsToInclude.size(); i++) {
-  		it = findNode(tipsToInclude[i]);
-  		/* move up tree adding nodes to label set */
-		jt = it;
-		while (nodetree.is_valid(jt)) {
-			nodeset.insert( (*jt).getNumber() );
-			jt = nodetree.parent(jt);
-		}
-  	}
-				
-	/* erase other nodes from the tree */
-	it = nodetree.begin();
-	while(it != nodetree.end()) {
-		if (nodeset.end() == nodeset.find( (*it).getNumber() )) {
-			it = nodetree.erase(it);
-		}
-		else {
-    		++it;
-    	}
-    }
-         
-	reduce();
+	pruneToMask( getTipsMask(tipsToInclude) );
 
-}	
+}
 
 /* removes a specified set of tips from tree */
 void CoalescentTree::removeTips(vector<string> tipsToExclude) {
 
+	pruneToMask( ~getTipsMask(tipsToExclude) );
 
-	/* start by finding numbers of all excluded tips */
-	set<int> nodeset; 
-	tree<Node>::iterator it, jt;
-	
-	for (int i=0; i < tipsToExclude.size(); i++) {
-		it = findNode(tipsToExclude[i]);	
-		int num = (*it).getNumber();
-		nodeset.insert(num);
+}
+
+/* reduces a tree to ancestors of a single tip */
+void CoalescentTree::pruneToName(string name) {
+
+	eraseUnmasked( getNameMask(name) );
+	modified();
+				
+}
+
+/* reduces a tree to samples within a specific time frame */
+void CoalescentTree::pruneToTime(double start, double stop) {
+
+	pruneToMask( getTimeMask(start,stop) );
+				
+}
+
+/* reduces a tree to tips selected by mask, along with their ancestors */
+/* masks can be combined beforehand, so that several prunes share a single pass and a single reduce */
+void CoalescentTree::pruneToMask(Mask mask) {
+
+	eraseUnmasked(mask);
+	reduce();
+	modified();
+
+}
+
+/* selects tips with label */
+Mask CoalescentTree::getLabelMask(string label) {
+
+	string key = "label " + label;
+	if (maskcache.find(key) != maskcache.end()) {
+		return maskcache[key];
 	}
-										
-	/* erase specified nodes from the tree */	
-	it = nodetree.begin();
-	while(it != nodetree.end()) {
-		int num = (*it).getNumber();
-		if (nodeset.find(num) != nodeset.end()) {	 // if found
-			it = nodetree.erase(it);
+
+	Mask mask (nodetree.size(), false);
+	int i = 0;
+	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it, ++i) {
+		if ( (*it).getLabel() == label && (*it).getLeaf() ) {
+			mask.set(i, true);
 		}
-		else {
-    		++it;
-    	}
-    }
-         
-	reduce();
+	}
+	
+	maskcache[key] = mask;
+	return mask;
 
-}	
+}
 
-/* reduces a tree to ancestors of a single tip */
-void CoalescentTree::pruneToName(string name) {
+/* selects tips with names in list */
+Mask CoalescentTree::getTipsMask(vector<string> tips) {
 
-	/* start by finding all tips with this label */
-	set<int> nodeset; 
-	tree<Node>::iterator it, jt;
+	set<string> tipset (tips.begin(), tips.end());
+	string key = "tips";
+	for (set<string>::iterator is = tipset.begin(); is != tipset.end(); ++is) {
+		key += " " + *is;
+	}
+	if (maskcache.find(key) != maskcache.end()) {
+		return maskcache[key];
+	}
 	
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		if ( (*it).getName() == name ) {
-		
-			/* move up tree adding nodes to label set */
-			jt = it;
-			while (nodetree.is_valid(jt)) {
-				nodeset.insert( (*jt).getNumber() );
-				jt = nodetree.parent(jt);
-			}
-		
+	Mask mask (nodetree.size(), false);
+	int i = 0;
+	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it, ++i) {
+		if ( tipset.find( (*it).getName() ) != tipset.end() ) {
+			mask.set(i, true);
 		}
 	}
-			
-	/* erase other nodes from the tree */
-	it = nodetree.begin();
-	while(it != nodetree.end()) {
-		if (nodeset.end() == nodeset.find( (*it).getNumber() )) {
-			it = nodetree.erase(it);
+	
+	maskcache[key] = mask;
+	return mask;
+
+}
+
+/* selects tips within a specific time frame */
+Mask CoalescentTree::getTimeMask(double start, double stop) {
+
+	stringstream ss;
+	ss.precision(17);
+	ss << "time " << start << " " << stop;
+	string key = ss.str();
+	if (maskcache.find(key) != maskcache.end()) {
+		return maskcache[key];
+	}
+
+	Mask mask (nodetree.size(), false);
+	int i = 0;
+	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it, ++i) {
+		if ( (*it).getTime() > start && (*it).getTime() < stop && (*it).getLeaf() ) {
+			mask.set(i, true);
 		}
-		else {
-    		++it;
-    	}
-    }
-        
-//	peelBack();     
-//	reduce();
-				
+	}
+	
+	maskcache[key] = mask;
+	return mask;
+
 }
 
-/* reduces a tree to samples within a specific time frame */
-void CoalescentTree::pruneToTime(double start, double stop) {
+/* selects tips on trunk, the trunk is made up of these tips and their ancestors */
+Mask CoalescentTree::getTrunkMask() {
 
-	/* start by finding all tips within this time frame */
-	set<int> nodeset; 
-	tree<Node>::iterator it, jt;
+	string key = "trunk";
+	if (maskcache.find(key) != maskcache.end()) {
+		return maskcache[key];
+	}
+
+	Mask mask (nodetree.size(), false);
+	int i = 0;
+	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it, ++i) {
+		if ( (*it).getTrunk() && (*it).getLeaf() ) {
+			mask.set(i, true);
+		}
+	}
 	
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		if ( (*it).getTime() > start && (*it).getTime() < stop && (*it).getLeaf() ) {
-		
-			/* move up tree adding nodes to label set */
-			jt = it;
-			while (nodetree.is_valid(jt)) {
-				nodeset.insert( (*jt).getNumber() );
-				jt = nodetree.parent(jt);
-			}
-		
+	maskcache[key] = mask;
+	return mask;
+
+}
+
+/* selects tips with name */
+Mask CoalescentTree::getNameMask(string name) {
+
+	string key = "name " + name;
+	if (maskcache.find(key) != maskcache.end()) {
+		return maskcache[key];
+	}
+
+	Mask mask (nodetree.size(), false);
+	int i = 0;
+	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it, ++i) {
+		if ( (*it).getName() == name ) {
+			mask.set(i, true);
 		}
 	}
-			
-	/* erase other nodes from the tree */
-	it = nodetree.begin();
-	while(it != nodetree.end()) {
-		if (nodeset.end() == nodeset.find( (*it).getNumber() )) {
-			it = nodetree.erase(it);
+	
+	maskcache[key] = mask;
+	return mask;
+
+}
+
+/* selects each tip with probability pro */
+/* a random number is drawn for every node, so that a given seed samples the same tips as before */
+Mask CoalescentTree::getRandomMask(double pro) {
+
+	Mask mask (nodetree.size(), false);
+	int i = 0;
+	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it, ++i) {
+		if ( rgen.uniform(0,1) < pro && (*it).getLeaf() ) {
+			mask.set(i, true);
 		}
-		else {
-    		++it;
-    	}
-    }
-        
-//	peelBack();     
-	reduce();
-				
+	}
+	return mask;
+
 }
 
 /* goes through an ancestral state tree and pads with migration events as an approximation of Markov jumps */
@@ -801,6 +903,7 @@ void CoalescentTree::padMigrationEvents() {
 				// create new intermediate node
 				Node migNode(nodeCount);
 				migNode.setLabel((*jt).getLabel());
+				migNode.setDiscretes((*it).getDiscretes());
 				migNode.setLength(firstLength);
 				migNode.setTime((*it).getTime() - secondLength);
 				nodeCount++;						
@@ -816,34 +919,121 @@ void CoalescentTree::padMigrationEvents() {
 		
 	}
 
+	modified();
+
 }
 
 /* sets all labels in tree to 1 */
 void CoalescentTree::collapseLabels() {
 
-	labelset.clear();
-	labelset.insert("1");
+	labelset.clear();
+	labelset.insert("1");
+
+	tree<Node>::iterator it, jt;
+	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
+		(*it).setLabel("1");
+	}
+
+	modified();
+
+}
+
+/* exchanges labels with a further discrete trait, so that every label statistic reads that trait */
+/* the label as read is restored before the exchange, and is selected again with 0 */
+void CoalescentTree::selectDiscrete(int k) {
+
+	if (k == discrete) {
+		return;
+	}
+	if (k < 0 || k > discreteSets.size()) {
+		throw runtime_error("discrete trait not found in tree");
+	}
+
+	int steps[2] = { discrete, k };
+	for (int j = 0; j < 2; j++) {
+		if (steps[j] > 0) {
+			for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it) {
+				(*it).swapLabel(steps[j]);
+			}
+			labelset.swap(discreteSets[steps[j] - 1]);
+		}
+	}
+	discrete = k;
+
+	modified();
+
+}
+
+/* trims a tree at its edges 
+
+   		   |-------	 			 |-----
+from  ------			 	to	--
+   		   |----------		 	 |-----
+
+*/
+void CoalescentTree::trimEnds(double start, double stop) {
+			
+	/* erase nodes from the tree where neither the node nor its parent are between start and stop */
+	/* parents pushed up to start are moved to the top level once every node has been visited, */
+	/* each directly after the first node, so the last one moved ends up first */
+	tree<Node>::iterator it, jt;
+	vector<tree<Node>::iterator> moved;
+	vector<tree<Node>::iterator> deferred;
+	
+	/* the first tree is visited before anything moved out of it, latest moved first, */
+	/* and then any other top level trees */
+	it = nodetree.begin();
+	trimFrom(it, it, start, stop, true, moved, deferred);
+	for (int i = deferred.size() - 1; i >= 0; i--) {
+		trimFrom(deferred[i], nodetree.parent(deferred[i]), start, stop, false, moved, deferred);
+	}
+	it = nodetree.next_sibling(nodetree.begin());
+	while (nodetree.is_valid(it)) {
+		trimFrom(it, it, start, stop, false, moved, deferred);
+		it = nodetree.next_sibling(it);
+	}
+	
+	for (int i = 0; i < moved.size(); i++) {
+		nodetree.move_after(nodetree.begin(),moved[i]);
+	}
+        
+    /* second pass for nodes < start */
+    it = nodetree.begin();   
+	while(it != nodetree.end()) {	
+		if ((*it).getTime() < start) {
+			it = nodetree.erase(it);
+		}
+		else {
+    		++it;
+    	}
+    }
+        
+	// go through tree and update lengths based on times
+	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
+		jt = nodetree.parent(it);
+		if (nodetree.is_valid(jt)) {
+			(*it).setLength( (*it).getTime() - (*jt).getTime() );
+		}
+	}	               
+               
+	reduce();
+
+	modified();
 
-	tree<Node>::iterator it, jt;
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		(*it).setLabel("1");
-	}
-							
 }
 
-/* trims a tree at its edges 
-
-   		   |-------	 			 |-----
-from  ------			 	to	--
-   		   |----------		 	 |-----
+/* visits nodes in preorder from it to the end of the subtree of top, trimming to start and stop */
+/* nodes are not moved here, but a moved parent has the rest of its subtree visited straight away, */
+/* or deferred if it left the first tree, before carrying on past it */
+void CoalescentTree::trimFrom(tree<Node>::iterator it, tree<Node>::iterator top, double start, double stop, bool defer,
+	vector<tree<Node>::iterator> &moved, vector<tree<Node>::iterator> &deferred) {
 
-*/
-void CoalescentTree::trimEnds(double start, double stop) {
-			
-	/* erase nodes from the tree where neither the node nor its parent are between start and stop */
-	tree<Node>::iterator it, jt;
-	it = nodetree.begin();
-	while(it != nodetree.end()) {	
+	tree<Node>::iterator jt, bt;
+	bt = top;
+	bt.skip_children();
+	++bt;
+	
+	while(it != bt) {	
 	
 		jt = nodetree.parent(it);
 	
@@ -858,55 +1048,39 @@ void CoalescentTree::trimEnds(double start, double stop) {
 				//(*it).setLeaf(false);
 				(*it).setLeaf(true);
 				nodetree.erase_children(it);
-				it = nodetree.begin();
 			
 			}
 			
 			/* if node > start and parent < start, push parent up to start */
 			/* and reparent anc[node] to be a child of root */
 			/* neither node nore anc[node] can be root */
-			else if ((*it).getTime() > start && (*jt).getTime() < start) {
+			/* a node just pruned back to stop is checked again here */
+			if ((*it).getTime() > start && (*jt).getTime() < start) {
 			
 				(*jt).setTime(start);
 				(*jt).setLength(0.0);
 				(*jt).setInclude(false);
-				nodetree.move_after(nodetree.begin(),jt);
-				it = nodetree.begin();
-			
-			}
+				
+				if (jt != nodetree.begin()) {
+					moved.push_back(jt);
+					if (defer) {
+						deferred.push_back(it);
+					}
+					else {
+						trimFrom(it, jt, start, stop, false, moved, deferred);
+					}
+					it = jt;
+					it.skip_children();
+				}
 			
-			else {
-				++it;
 			}
 		
 		}
 		
-		else {
-    		++it;
-    	}
-    }
-        
-    /* second pass for nodes < start */
-    it = nodetree.begin();   
-	while(it != nodetree.end()) {	
-		if ((*it).getTime() < start) {
-			it = nodetree.erase(it);
-		}
-		else {
-    		++it;
-    	}
+   		++it;
+   		
     }
-        
-	// go through tree and update lengths based on times
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {
-			(*it).setLength( (*it).getTime() - (*jt).getTime() );
-		}
-	}	               
-               
-	reduce();
-					
+
 }
 
 /* cuts up tree into multiple sections */
@@ -930,6 +1104,7 @@ void CoalescentTree::sectionTree(double start, double window, double step) {
 		
 			// operations all affect nodetree
 			nodetree = holdtree;
+			modified();
 			trimEnds(t,t + window);	
 			current = renumber(current);			// need unique node numbers
 			
@@ -957,7 +1132,9 @@ void CoalescentTree::sectionTree(double start, double window, double step) {
 	}
 
 	nodetree = newtree;
-	
+
+	modified();
+
 }
 
 /* Reduces tree to just the ancestors of a single slice in time */
@@ -965,73 +1142,85 @@ void CoalescentTree::sectionTree(double start, double window, double step) {
 void CoalescentTree::timeSlice(double slice) {
 
 	/* desire only nodes spanning the time slice */
-	/* find these nodes and add them and their ancestors to a set */
-	set<int> sliceset; 
-	tree<Node>::iterator it, jt, kt;
-	it = nodetree.begin();
-	while(it != nodetree.end()) {	
+	/* find these nodes in preorder, skipping anything below a node already cut back, then mark */
+	/* them and their ancestors in a single sweep back through preorder */
+	vector<tree<Node>::iterator> nodes;
+	vector<int> parents;
+	flatten(nodes, parents);
+	
+	vector<char> cut (nodes.size(), false);
+	vector<char> below (nodes.size(), false);
+	vector<char> keep (nodes.size(), false);
+	for (int i = 0; i < nodes.size(); i++) {
+		int j = parents[i];
+		if (j >= 0) {
+			below[i] = below[j] || cut[j];
+			if (!below[i] && (*nodes[i]).getTime() > slice && (*nodes[j]).getTime() <= slice) {
+				cut[i] = true;
+			}
+		}
+	}
+	for (int i = nodes.size() - 1; i >= 0; i--) {
+		if (cut[i]) {
+			keep[i] = true;
+		}
+		if (keep[i] && parents[i] >= 0) {
+			keep[parents[i]] = true;
+		}
+	}
 	
-		jt = nodetree.parent(it);
+	/* if node > slice and parent < slice, erase children and prune node back to stop */
+	/* this pruning causes an internal node to become a leaf node */
+	for (int i = 0; i < nodes.size(); i++) {
+		if (cut[i]) {
 		
-		if (nodetree.is_valid(jt)) {
-	
-			/* if node > slice and parent < slice, erase children and prune node back to stop */
-			/* this pruning causes an internal node to become a leaf node */
-			if ((*it).getTime() > slice && (*jt).getTime() <= slice) {
-			
-			
-				// finding rate of location change
-				double xlocdiff = (*it).getX() - (*jt).getX();
-				double ylocdiff = (*it).getY() - (*jt).getY();
-				double xcoorddiff = (*it).getXCoord() - (*jt).getXCoord();
-				double ycoorddiff = (*it).getYCoord() - (*jt).getYCoord();				
-				double timediff = (*it).getTime() - (*jt).getTime();
-				double xlocrate = xlocdiff / timediff;
-				double ylocrate = ylocdiff / timediff;
-				double xcoordrate = xcoorddiff / timediff;;
-				double ycoordrate = ycoorddiff / timediff;;				
-			
-				// adjusting node
-				(*it).setTime( slice );
-				(*it).setLength( (*it).getTime() - (*jt).getTime() );
-				(*it).setX( (*jt).getX() + (*it).getLength() * xlocrate );
-				(*it).setY( (*jt).getY() + (*it).getLength() * ylocrate );
-				(*it).setXCoord( (*jt).getXCoord() + (*it).getLength() * xcoordrate );
-				(*it).setYCoord( (*jt).getYCoord() + (*it).getLength() * ycoordrate );
-				(*it).setLeaf(true);
-				nodetree.erase_children(it);
-				
-				// move up tree adding nodes to sliceset
-				jt = it;
-				while (nodetree.is_valid(jt)) {
-					sliceset.insert( (*jt).getNumber() );
-					jt = nodetree.parent(jt);
-				}
-				
-				it = nodetree.begin();
+			tree<Node>::iterator it = nodes[i];
+			tree<Node>::iterator jt = nodes[parents[i]];
+		
+			// finding rate of location change
+			double xlocdiff = (*it).getX() - (*jt).getX();
+			double ylocdiff = (*it).getY() - (*jt).getY();
+			double xcoorddiff = (*it).getXCoord() - (*jt).getXCoord();
+			double ycoorddiff = (*it).getYCoord() - (*jt).getYCoord();				
+			double timediff = (*it).getTime() - (*jt).getTime();
+			double xlocrate = xlocdiff / timediff;
+			double ylocrate = ylocdiff / timediff;
+			double xcoordrate = xcoorddiff / timediff;;
+			double ycoordrate = ycoorddiff / timediff;;				
+		
+			// adjusting node
+			(*it).setTime( slice );
+			(*it).setLength( (*it).getTime() - (*jt).getTime() );
+			(*it).setX( (*jt).getX() + (*it).getLength() * xlocrate );
+			(*it).setY( (*jt).getY() + (*it).getLength() * ylocrate );
+			(*it).setXCoord( (*jt).getXCoord() + (*it).getLength() * xcoordrate );
+			(*it).setYCoord( (*jt).getYCoord() + (*it).getLength() * ycoordrate );
+			for (int k = 2; k < dimensions; k++) {
+				double traitrate = ((*it).getTrait(k) - (*jt).getTrait(k)) / timediff;
+				(*it).setTrait(k, (*jt).getTrait(k) + (*it).getLength() * traitrate);
+			}
+			(*it).setLeaf(true);
 			
+		}
+	}
+	
+	/* erase other nodes from the tree, cut nodes lose their children */
+	for (int i = 0; i < nodes.size(); i++) {
+		if (parents[i] < 0 || (keep[parents[i]] && !cut[parents[i]])) {
+			if (!keep[i]) {
+				nodetree.erase(nodes[i]);
+			}
+			else if (cut[i]) {
+				nodetree.erase_children(nodes[i]);
 			}
-			else { ++it; }
-    	
-    	}
-    	else { ++it; }
-    	
-    }
-        
-	/* erase other nodes from the tree */
-	it = nodetree.begin();
-	while(it != nodetree.end()) {
-		if (sliceset.end() == sliceset.find( (*it).getNumber() )) {
-			it = nodetree.erase(it);
 		}
-		else {
-	   		++it;
-    	}
-	}    
+	}
     
 	peelBack();
 	reduce();
 
+	modified();
+
 }
 
 /* Removes descendents of trunk from tree at a single slice in time */
@@ -1057,16 +1246,14 @@ void CoalescentTree::trunkSlice(double slice) {
 			(*it).setLeaf(true);
 			nodetree.erase_children(it);
 		
-			it = nodetree.begin();
-		
 		}
 		
-		else {
-    		++it;
-    	}
+   		++it;
     	
     }
-        
+
+	modified();
+
 }
 
 /* Reduces tree to just the ancestors of leaf nodes existing in a particular window of time */
@@ -1074,44 +1261,34 @@ void CoalescentTree::trunkSlice(double slice) {
 void CoalescentTree::leafSlice(double start, double stop) {
 
 	/* desire only nodes spanning the time slice */
-	/* find these nodes and add them and their ancestors to a set */
-	set<int> sliceset; 
-	tree<Node>::iterator it, jt, kt;
-	it = nodetree.begin();
-	while(it != nodetree.end()) {	
-	
-		/* if node > start AND node < stop && node is leaf */
-		/* add ancestors to sliceset */
-		/* there will be no children to erase */
+	/* mark leaf nodes in window, and pass marks up to parents in a single sweep back through preorder */
+	vector<tree<Node>::iterator> nodes;
+	vector<int> parents;
+	flatten(nodes, parents);
+	
+	vector<char> keep (nodes.size(), false);
+	for (int i = nodes.size() - 1; i >= 0; i--) {
+		tree<Node>::iterator it = nodes[i];
 		if ((*it).getTime() > start && (*it).getTime() <= stop && (*it).getLeaf()) {
-		
-			// move up tree adding nodes to sliceset
-			jt = it;
-			while (nodetree.is_valid(jt)) {
-				sliceset.insert( (*jt).getNumber() );
-				jt = nodetree.parent(jt);
-			}
-				
+			keep[i] = true;
 		}
-		
-		++it;
-    	
-    }
+		if (keep[i] && parents[i] >= 0) {
+			keep[parents[i]] = true;
+		}
+	}
     
 	/* erase other nodes from the tree */
-	it = nodetree.begin();
-	while(it != nodetree.end()) {
-		if (sliceset.end() == sliceset.find( (*it).getNumber() )) {
-			it = nodetree.erase(it);
+	for (int i = 0; i < nodes.size(); i++) {
+		if (!keep[i] && (parents[i] < 0 || keep[parents[i]])) {
+			nodetree.erase(nodes[i]);
 		}
-		else {
-    		++it;
-    	}
-    }    
+	}
     
 	peelBack();
 	reduce();
 
+	modified();
+
 }
 
 
@@ -1149,6 +1326,7 @@ void CoalescentTree::padTree() {
 
 				Node newNode(current);
 				newNode.setLabel( (*it).getLabel() );
+				newNode.setDiscretes( (*it).getDiscretes() );
 				newNode.setTime( *is );
 				newNode.setLength( *is - (*it).getTime() );
 				
@@ -1164,7 +1342,9 @@ void CoalescentTree::padTree() {
 		++it;
 	
 	}
-			  	
+
+	modified();
+
 }
 
 /* rotate X&Y locations around origin with degrees in radians */
@@ -1181,7 +1361,7 @@ void CoalescentTree::rotateLoc(double deg) {
 
 }
 
-/* walk down tree and replace xloc and yloc with accumulated totals */
+/* walk down tree and replace every trait with accumulated totals */
 void CoalescentTree::accumulateLoc() {
 	tree<Node>::iterator it, jt;
 	for (it = nodetree.begin(); it != nodetree.end(); ++it ) {
@@ -1195,6 +1375,9 @@ void CoalescentTree::accumulateLoc() {
 			yloc = yloc + parent_yloc;
 			(*it).setX(xloc);
 			(*it).setY(yloc);			
+			for (int k = 2; k < dimensions; k++) {
+				(*it).setTrait(k, (*it).getTrait(k) + (*jt).getTrait(k));
+			}
 		}
 	}
 }
@@ -1211,10 +1394,12 @@ void CoalescentTree::addTail(double setback) {
 	// create new root node
 	Node newNode(-1);
 	newNode.setLabel( (*rt).getLabel() );
+	newNode.setDiscretes( (*rt).getDiscretes() );
 	newNode.setTime( (*rt).getTime() - setback );
 	newNode.setLength(0.0);
-	newNode.setX( (*rt).getX() );
-	newNode.setY( (*rt).getY() );
+	for (int k = 0; k < dimensions; k++) {
+		newNode.setTrait(k, (*rt).getTrait(k));
+	}
 	newNode.setXCoord( (*rt).getXCoord() );	
 	newNode.setYCoord( (*rt).getYCoord() );		
 	newNode.setLeaf(false);	
@@ -1224,8 +1409,98 @@ void CoalescentTree::addTail(double setback) {
 	(*rt).setLength(setback);
 		
 	// wrap this new node so that it inherits the old node
-	nodetree.wrap(rt,newNode);	
+	nodetree.wrap(rt,newNode);
+
+	modified();
+
+}
+
+/* walks the tree once in preorder, opening a parenthesis on the way down to each child and closing */
+/* it on the way back up, nodes are written after their children as NEWICK requires */
+/* if sectioning has left several trees at the top level, these are joined at an unannotated root */
+void CoalescentTree::printNewick(string &out) {
+
+	tree<Node>::iterator it, jt;
+	bool forest = nodetree.is_valid( nodetree.next_sibling(nodetree.begin()) );
+	
+	if (forest) {
+		out += '(';
+	}
+	
+	it = nodetree.begin();
+	while (nodetree.is_valid(it)) {
+	
+		/* down to first tip */
+		while (nodetree.number_of_children(it) > 0) {
+			out += '(';
+			it = nodetree.child(it,0);
+		}
+		appendNode(out, it);
+		
+		/* up to next sibling, closing finished nodes */
+		jt = nodetree.next_sibling(it);
+		while (!nodetree.is_valid(jt)) {
+			it = nodetree.parent(it);
+			if (!nodetree.is_valid(it)) {
+				break;
+			}
+			out += ')';
+			appendNode(out, it);
+			jt = nodetree.next_sibling(it);
+		}
+		
+		if (nodetree.is_valid(jt)) {
+			out += ',';
+		}
+		it = jt;
+		
+	}
+	
+	if (forest) {
+		out += ')';
+	}
+	out += ';';
+
+}
+
+void CoalescentTree::appendNode(string &out, tree<Node>::iterator it) {
+
+	out += (*it).getName();
+	out += "[&states=\"";
+	out += (*it).getLabel();
+	out += "\",rate=";
+	appendNumber(out, (*it).getRate());
+	out += ",antigenic={";
+	for (int k = 0; k < dimensions; k++) {
+		if (k > 0) { out += ','; }
+		appendNumber(out, (*it).getTrait(k));
+	}
+	out += '}';
 	
+	/* kept columns follow, unless they would repeat an annotation already written */
+	int row = (*it).getRow();
+	for (int a = 0; a < annotations.size(); a++) {
+		string key = annotations[a].getName();
+		if (annotations[a].has(row) && key != "states" && key != "rate" && key != "antigenic") {
+			out += ',';
+			annotations[a].append(out, row);
+		}
+	}
+	out += ']';
+	
+	/* trees joined at the top level keep their lengths, so that they read back the same */
+	bool forest = nodetree.is_valid( nodetree.next_sibling(nodetree.begin()) );
+	if (nodetree.is_valid(nodetree.parent(it)) || forest) {
+		out += ':';
+		appendNumber(out, (*it).getLength());
+	}
+
+}
+
+void CoalescentTree::appendNumber(string &out, double n) {
+	char buffer[32];
+	int length = snprintf(buffer, sizeof(buffer), "%.10g", n);
+	out.append(buffer, length);
 }
 
 /* Print indented tree */
@@ -1264,11 +1539,17 @@ Output is:
 */	
 void CoalescentTree::printRuleList(string outputFile, bool isCircular) {
 
-//	printTree();
-
 	/* initializing output stream */
 	ofstream outStream;
 	outStream.open( outputFile.c_str(),ios::app);
+	printRuleList(outStream, isCircular);
+	outStream.close();
+
+}
+
+void CoalescentTree::printRuleList(ostream &outStream, bool isCircular) {
+
+//	printTree();
 
 	/* setting up y-axis ordering, x-axis is date */
 	if (isCircular) {
@@ -1333,17 +1614,22 @@ void CoalescentTree::printRuleList(string outputFile, bool isCircular) {
 	}
 	outStream << endl;  	
 	  	  	
-	outStream.close();
 	  	  	
 }
 
 void CoalescentTree::printRuleListWithOrdering(string outputFile, vector<string> tipOrdering) {
 
-//	printTree();
-
 	/* initializing output stream */
 	ofstream outStream;
 	outStream.open( outputFile.c_str(),ios::app);
+	printRuleListWithOrdering(outStream, tipOrdering);
+	outStream.close();
+
+}
+
+void CoalescentTree::printRuleListWithOrdering(ostream &outStream, vector<string> tipOrdering) {
+
+//	printTree();
 
 	/* setting up y-axis ordering, x-axis is date */
 	setCoords(tipOrdering);
@@ -1403,7 +1689,6 @@ void CoalescentTree::printRuleListWithOrdering(string outputFile, vector<string>
 	}
 	outStream << endl;  	
 	  	  	
-	outStream.close();
 	  	  	
 }
 
@@ -1460,40 +1745,24 @@ void CoalescentTree::printParen() {
 
 /* most recent node in tree, will always be a leaf */
 double CoalescentTree::getPresentTime() {
-	
-	double t = (*nodetree.begin()).getTime();
-	for (tree<Node>::leaf_iterator it = nodetree.begin_leaf(); it != nodetree.end_leaf(); ++it) {
-		if ((*it).getTime() > t) { 
-			t = (*it).getTime(); 
-		}
-	}
-	return t;
-
+	if (!aggregated) { aggregate(); }
+	return presentTime;
 }
 
 /* most ancient node in tree */
 double CoalescentTree::getRootTime() {
-
-	double t = (*nodetree.begin()).getTime();
-	for (tree<Node>::leaf_iterator it = nodetree.begin_leaf(); it != nodetree.end_leaf(); ++it) {
-		if ((*it).getTime() < t) { 
-			t = (*it).getTime(); 
-		}
-	}
-	return t;
+	if (!aggregated) { aggregate(); }
+	return rootTime;
 }
 
 /* amount of time it takes for all samples to coalesce */
 double CoalescentTree::getTMRCA() {
 	
-	int leafcount = 0;
-	for (tree<Node>::leaf_iterator it = nodetree.begin_leaf(); it != nodetree.end_leaf(); ++it) {
-		leafcount++;
-	}
+	if (!aggregated) { aggregate(); }
 	
 	double tmrca = 0.0;
-	if (leafcount > 1) {
-		tmrca = getPresentTime() - getRootTime();
+	if (tipCount > 1) {
+		tmrca = presentTime - rootTime;
 	}
 	else {
 		tmrca /= tmrca;
@@ -1518,45 +1787,31 @@ double CoalescentTree::getTMRCA() {
 
 /* number of leaf nodes */
 int CoalescentTree::getLeafCount() {
-
-	double n = 0;
-	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it ) {
-		if ( (*it).getLeaf() ) {
-			n++;
-		}
-	}	
-	return n;
-
+	if (!aggregated) { aggregate(); }
+	return leafCount;
 }
 
 /* total number of nodes */
 int CoalescentTree::getNodeCount() {
-	return nodetree.size();
+	if (!aggregated) { aggregate(); }
+	return nodeCount;
 }
 
 /* total length of the tree */
 double CoalescentTree::getLength() {
-
-	double length = 0.0;
-	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it ) {
-		if ( (*it).getInclude() ) {
-			length += (*it).getLength();
-		}
-	}	
-	return length;
-
+	if (!aggregated) { aggregate(); }
+	return totalLength;
 }
 
 /* length of the tree with label l */
 double CoalescentTree::getLength(string l) {
 
-	double length = 0.0;
-	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it ) {
-		if ( (*it).getInclude() && (*it).getLabel() == l ) {
-			length += (*it).getLength();
-		}
-	}	
-	return length;
+	if (!aggregated) { aggregate(); }
+	int i = findLabel(l);
+	if (i < 0) {
+		return 0.0;
+	}
+	return labelLengths[i];
 
 }
 
@@ -1600,6 +1855,14 @@ set<string> CoalescentTree::getLabelSet() {
 	return labelset;
 }
 
+int CoalescentTree::getDiscreteCount() {
+	return 1 + discreteSets.size();
+}
+
+map<string,Annotation::Type> CoalescentTree::getAnnotationTypes() {
+	return annotationTypes;
+}
+
 /* returns the proportion of branches with a particular label back from tips */
 double CoalescentTree::getLabelProFromTips(string l, double timeWindow) {
 
@@ -1652,18 +1915,81 @@ double CoalescentTree::getLabelProFromTips(string l, double timeWindow, string s
 
 }
 
-/* returns the count of coalescent events */
-int CoalescentTree::getCoalCount() {
+/* returns the proportion of tips with each starting label whose lineage has each ending label at each time back */
+/* every tip is walked back once, stepping through the times in increasing order as it goes up the lineage */
+/* each step stops where getNodeBackFromTip would, so values match getLabelProFromTips(end, time, start) */
+vector<double> CoalescentTree::getLabelProHistoryFromTips(vector<string> labels, vector<double> windows) {
 
-	/* count coalescent events, these are nodes with two children */
-	int count = 0;
+	int L = labels.size();
+	int T = windows.size();
+	
+	map<string,int> index;
+	for (int i = 0; i < L; i++) {
+		index[labels[i]] = i;
+	}
+	
+	/* visit times in increasing order */
+	vector<int> order;
+	for (int k = 0; k < T; k++) {
+		int j = order.size();
+		order.push_back(k);
+		while (j > 0 && windows[order[j-1]] > windows[k]) {
+			order[j] = order[j-1];
+			j--;
+		}
+		order[j] = k;
+	}
+	
+	vector<double> pro (L * L * T, 0.0);
+	vector<double> count (L, 0.0);
+	
 	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it) {
-		if ((*it).getInclude() && nodetree.number_of_children(it) == 2) {		
-			count++;
+		if ( (*it).getLeaf() ) {
+		
+			map<string,int>::iterator mt = index.find( (*it).getLabel() );
+			if (mt == index.end()) {
+				continue;
+			}
+			int start = mt->second;
+			count[start] += 1.0;
+			
+			double initialTime = (*it).getTime();
+			tree<Node>::iterator kt = it;
+			tree<Node>::iterator jt = nodetree.parent(kt);
+			
+			for (int k = 0; k < T; k++) {
+				double finalTime = initialTime - windows[order[k]];
+				while ( nodetree.is_valid(jt) && (*jt).getTime() > finalTime ) {
+					kt = jt;
+					jt = nodetree.parent(kt);
+				}
+				mt = index.find( (*kt).getLabel() );
+				if (mt != index.end()) {
+					pro[(start * L + mt->second) * T + order[k]] += 1.0;
+				}
+			}
+			
 		}
 	}
 	
-	return count;
+	for (int a = 0; a < L; a++) {
+		for (int b = 0; b < L; b++) {
+			for (int k = 0; k < T; k++) {
+				pro[(a * L + b) * T + k] /= count[a];
+			}
+		}
+	}
+	
+	return pro;
+
+}
+
+/* returns the count of coalescent events */
+int CoalescentTree::getCoalCount() {
+
+	/* coalescent events are nodes with two children, counted when aggregating */
+	if (!aggregated) { aggregate(); }
+	return coalTotal;
 
 }
 
@@ -1691,14 +2017,12 @@ int CoalescentTree::getCoalCountTrunk() {
 /* returns the count of coalescent events with label */
 int CoalescentTree::getCoalCount(string l) {
 
-	/* count coalescent events, these are nodes with two children */
-	int count = 0;
-	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it) {
-		if ((*it).getInclude() && nodetree.number_of_children(it) == 2 && (*it).getLabel() == l ) {		
-			count++;
-		}
+	if (!aggregated) { aggregate(); }
+	int i = findLabel(l);
+	if (i < 0) {
+		return 0;
 	}
-	return count;
+	return coalCounts[i];
 
 }
 
@@ -1808,36 +2132,22 @@ double CoalescentTree::getCoalRate(string l) {
 /* returns the count of migration events over entire tree */
 int CoalescentTree::getMigCount() {
 
-	/* count migration events, these are nodes in which the parent label differs from child label */
-	tree<Node>::iterator it, jt;
-	int count = 0;
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {		
-			if ( (*it).getInclude() && (*jt).getInclude() && (*it).getLabel() != (*jt).getLabel() ) {		
-				count++;
-			}
-		}
-	}
-	return count;
+	/* migration events are nodes in which the parent label differs from child label, counted when aggregating */
+	if (!aggregated) { aggregate(); }
+	return migTotal;
 
 }
 
 /* returns the count of migration events from label to label */
 int CoalescentTree::getMigCount(string from, string to) {
 
-	/* count migration events, these are nodes in which the parent label differs from child label */
-	tree<Node>::iterator it, jt;
-	int count = 0;
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {
-			if ( (*it).getInclude() && (*jt).getInclude() && (*it).getLabel() == to && (*jt).getLabel() == from ) {		
-				count++;
-			}
-		}
+	if (!aggregated) { aggregate(); }
+	int i = findLabel(from);
+	int j = findLabel(to);
+	if (i < 0 || j < 0) {
+		return 0;
 	}
-	return count;
+	return migCounts[i * labelIndex.size() + j];
 
 }
 
@@ -2160,303 +2470,136 @@ double CoalescentTree::getTajimaD() {
 
 }
 
+int CoalescentTree::getDimensions() {
+	return dimensions;
+}
+
 /* returns the coefficient of diffusion across the tree */
+/* each coefficient compares Euclidean distance between parent and child nodes, totalled over branches */
+/* and over every trait dimension, as squared displacement / (2 * dimensions * time) */
 double CoalescentTree::getDiffusionCoefficient() {
-
-	/* compare Euclidean distance between parent and child nodes */
-	tree<Node>::iterator it, jt;
-	double coefficient = 0;	
-	double count = 0;
-	double totalSqDist = 0;
-	double totalTime = 0;		
-		
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {	
-		
-			double diffX = (*it).getX() - (*jt).getX();
-			double diffY = (*it).getY() - (*jt).getY();
-			double sqDistX = diffX * diffX;
-			double sqDistY = diffY * diffY;			
-			double sqDist = sqDistX + sqDistY;
-			double time = (*it).getTime() - (*jt).getTime();
-			
-			// first estimate drift coefficient
-			double mu = diffX / time;
-			
-			// then estimate diffusion coefficient			
-			coefficient += sqDist / (4.0*time);
-//			coefficient += ( sqDist - mu*mu*time*time ) / (time);
-				
-			totalSqDist += sqDist;
-			totalTime += time;					
-			count += 1;
-	
-		}
-	}
-	
-	coefficient /= count;
-	coefficient = totalSqDist / (4.0*totalTime);	
-	return coefficient;
-
+	vector<double> sqDists, dists, times;
+	sumBranches(sqDists, dists, times);
+	return sqDists[ALLBRANCHES] / (2.0 * dimensions * times[ALLBRANCHES]);
 }
 
 /* returns the coefficient of diffusion across the trunk */
 double CoalescentTree::getDiffusionCoefficientTrunk() {
-
-	/* compare Euclidean distance between parent and child nodes */
-	tree<Node>::iterator it, jt;
-	double coefficient = 0;	
-	double count = 0;
-	double totalSqDist = 0;
-	double totalTime = 0;	
-		
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {	
-			if ( (*it).getTrunk() && (*jt).getTrunk() ) {
-		
-				double diffX = (*it).getX() - (*jt).getX();
-				double diffY = (*it).getY() - (*jt).getY();
-				double sqDistX = diffX * diffX;
-				double sqDistY = diffY * diffY;			
-				double sqDist = sqDistX + sqDistY;
-				double time = (*it).getTime() - (*jt).getTime();
-				
-				// first estimate drift coefficient
-				double mu = diffX / time;
-				
-				// then estimate diffusion coefficient			
-				coefficient += sqDist / (4.0*time);
-//				coefficient += ( sqDist - mu*mu*time*time ) / (time);
-					
-				totalSqDist += sqDist;
-				totalTime += time;					
-				count += 1;
-	
-			}
-		}
-	}
-	
-	coefficient /= count;
-	coefficient = totalSqDist / (4.0*totalTime);	
-	return coefficient;
-
+	vector<double> sqDists, dists, times;
+	sumBranches(sqDists, dists, times);
+	return sqDists[TRUNKBRANCHES] / (2.0 * dimensions * times[TRUNKBRANCHES]);
 }
 
 /* returns the coefficient of diffusion across side branches */
 double CoalescentTree::getDiffusionCoefficientSideBranches() {
-
-	/* compare Euclidean distance between parent and child nodes */
-	tree<Node>::iterator it, jt;
-	double coefficient = 0;	
-	double count = 0;
-	double totalSqDist = 0;
-	double totalTime = 0;		
-		
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {	
-			if ( !(*it).getTrunk() && !(*jt).getTrunk() ) {
-		
-				double diffX = (*it).getX() - (*jt).getX();
-				double diffY = (*it).getY() - (*jt).getY();
-				double sqDistX = diffX * diffX;
-				double sqDistY = diffY * diffY;			
-				double sqDist = sqDistX + sqDistY;
-				double time = (*it).getTime() - (*jt).getTime();
-				
-				// first estimate drift coefficient
-				double mu = diffX / time;
-				
-				// then estimate diffusion coefficient			
-				coefficient += sqDist / (4.0*time);
-//				coefficient += ( sqDist - mu*mu*time*time ) / (time);
-					
-				totalSqDist += sqDist;
-				totalTime += time;					
-				count += 1;
-	
-			}
-		}
-	}
-	
-	coefficient /= count;
-	coefficient = totalSqDist / (4.0*totalTime);
-	return coefficient;
-
+	vector<double> sqDists, dists, times;
+	sumBranches(sqDists, dists, times);
+	return sqDists[SIDEBRANCHES] / (2.0 * dimensions * times[SIDEBRANCHES]);
 }
 
-/* returns the coefficient of diffusion across side branches */
+/* returns the coefficient of diffusion across internal side branches */
 double CoalescentTree::getDiffusionCoefficientInternalBranches() {
-
-	/* compare Euclidean distance between parent and child nodes */
-	tree<Node>::iterator it, jt;
-	double coefficient = 0;	
-	double count = 0;
-	double totalSqDist = 0;
-	double totalTime = 0;		
-		
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {	
-			if ( !(*it).getLeaf() && !(*it).getTrunk() && !(*jt).getTrunk() ) {
-		
-				double diffX = (*it).getX() - (*jt).getX();
-				double diffY = (*it).getY() - (*jt).getY();
-				double sqDistX = diffX * diffX;
-				double sqDistY = diffY * diffY;			
-				double sqDist = sqDistX + sqDistY;
-				double time = (*it).getTime() - (*jt).getTime();
-				
-				// first estimate drift coefficient
-				double mu = diffX / time;
-				
-				// then estimate diffusion coefficient			
-				coefficient += sqDist / (4.0*time);
-	//			coefficient += ( sqDist - mu*mu*time*time ) / (time);
-					
-				totalSqDist += sqDist;
-				totalTime += time;					
-				count += 1;
-	
-			}
-		}
-	}
-	
-	coefficient /= count;	
-	coefficient = totalSqDist / (4.0*totalTime);	
-	return coefficient;
-
+	vector<double> sqDists, dists, times;
+	sumBranches(sqDists, dists, times);
+	return sqDists[INTERNALBRANCHES] / (2.0 * dimensions * times[INTERNALBRANCHES]);
 }
 
 /* returns the rate of drift of x location across the tree */
 double CoalescentTree::getDriftRate() {
-
-	/* compare Euclidean distance between parent and child nodes */
-	tree<Node>::iterator it, jt;
-	double rate = 0;	
-	double count = 0;
-	double totalDist = 0;
-	double totalTime = 0;		
-		
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {	
-		
-			double dist = (*it).getX() - (*jt).getX();			
-			double time = (*it).getTime() - (*jt).getTime();
-					
-			rate += dist / time;
-			count += 1;
-			totalDist += dist;
-			totalTime += time;
-	
-		}
-	}
-	
-	rate /= count;
-	rate = totalDist / totalTime;
-	return rate;
-
+	vector<double> sqDists, dists, times;
+	sumBranches(sqDists, dists, times);
+	return dists[ALLBRANCHES] / times[ALLBRANCHES];
 }
 
-/* returns the rate of drift of x location across the tree */
+/* returns the rate of drift of x location across the trunk */
 double CoalescentTree::getDriftRateTrunk() {
+	vector<double> sqDists, dists, times;
+	sumBranches(sqDists, dists, times);
+	return dists[TRUNKBRANCHES] / times[TRUNKBRANCHES];
+}
 
-	/* compare Euclidean distance between parent and child nodes */
-	tree<Node>::iterator it, jt;
-	double rate = 0;	
-	double count = 0;
-	double totalDist = 0;
-	double totalTime = 0;		
-		
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {	
-			if ( (*it).getTrunk() && (*jt).getTrunk() ) {
-		
-				double dist = (*it).getX() - (*jt).getX();			
-				double time = (*it).getTime() - (*jt).getTime();
-								
-				rate += dist / time;
-				count += 1;
-				totalDist += dist;
-				totalTime += time;				
-	
-			}
-		}
-	}
-	
-	rate /= count;
-	rate = totalDist / totalTime;	
-	return rate;
+/* returns the rate of drift of x location across side branches */
+double CoalescentTree::getDriftRateSideBranches() {
+	vector<double> sqDists, dists, times;
+	sumBranches(sqDists, dists, times);
+	return dists[SIDEBRANCHES] / times[SIDEBRANCHES];
+}
 
+/* returns the rate of drift of x location across internal side branches */
+double CoalescentTree::getDriftRateInternalBranches() {
+	vector<double> sqDists, dists, times;
+	sumBranches(sqDists, dists, times);
+	return dists[INTERNALBRANCHES] / times[INTERNALBRANCHES];
 }
 
-/* returns the rate of drift of x location across the tree */
-double CoalescentTree::getDriftRateSideBranches() {
+/* each trait dimension is gathered into a contiguous column, so that displacements along every branch */
+/* are computed in loops that vectorize, then each branch is added to the totals of its classes */
+/* totals are added in preorder, the order in which separate passes over the tree added them */
+void CoalescentTree::sumBranches(vector<double> &sqDists, vector<double> &dists, vector<double> &times) {
 
-	/* compare Euclidean distance between parent and child nodes */
-	tree<Node>::iterator it, jt;
-	double rate = 0;	
-	double count = 0;
-	double totalDist = 0;
-	double totalTime = 0;		
+	vector<tree<Node>::iterator> nodes;
+	vector<int> parents;
+	flatten(nodes, parents);
+	int n = nodes.size();
 	
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {	
-			if ( !(*it).getTrunk() && !(*jt).getTrunk() ) {
-		
-				double dist = (*it).getX() - (*jt).getX();			
-				double time = (*it).getTime() - (*jt).getTime();
-								
-				rate += dist / time;
-				count += 1;
-				totalDist += dist;
-				totalTime += time;					
+	vector<double> t (n);
+	vector<int> from (n);
+	vector<char> trunk (n);
+	vector<char> leaf (n);
+	for (int i = 0; i < n; i++) {
+		t[i] = (*nodes[i]).getTime();
+		trunk[i] = (*nodes[i]).getTrunk();
+		leaf[i] = (*nodes[i]).getLeaf();
+		from[i] = parents[i] >= 0 ? parents[i] : i;
+	}
 	
-			}
+	/* squared displacement is added up one dimension at a time, x first */
+	vector<double> column (n);
+	vector<double> dx (n);
+	vector<double> sq (n);
+	vector<double> dt (n);
+	for (int i = 0; i < n; i++) {
+		column[i] = (*nodes[i]).getX();
+	}
+	for (int i = 0; i < n; i++) {
+		dx[i] = column[i] - column[from[i]];
+		sq[i] = dx[i] * dx[i];
+	}
+	for (int k = 1; k < dimensions; k++) {
+		for (int i = 0; i < n; i++) {
+			column[i] = (*nodes[i]).getTrait(k);
+		}
+		for (int i = 0; i < n; i++) {
+			double diff = column[i] - column[from[i]];
+			sq[i] += diff * diff;
 		}
 	}
+	for (int i = 0; i < n; i++) {
+		dt[i] = t[i] - t[from[i]];
+	}
 	
-	rate /= count;	
-	rate = totalDist / totalTime;	
-	return rate;
-
-}
-
-/* returns the rate of drift of x location across the tree */
-double CoalescentTree::getDriftRateInternalBranches() {
-
-	/* compare Euclidean distance between parent and child nodes */
-	tree<Node>::iterator it, jt;
-	double rate = 0;	
-	double count = 0;
-	double totalDist = 0;
-	double totalTime = 0;		
-		
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
-		jt = nodetree.parent(it);
-		if (nodetree.is_valid(jt)) {	
-			if ( !(*it).getLeaf() && !(*it).getTrunk() && !(*jt).getTrunk() ) {
-		
-				double dist = (*it).getX() - (*jt).getX();			
-				double time = (*it).getTime() - (*jt).getTime();
-									
-				rate += dist / time;
-				count += 1;
-				totalDist += dist;
-				totalTime += time;					
-	
-			}
+	sqDists.assign(4, 0.0);
+	dists.assign(4, 0.0);
+	times.assign(4, 0.0);
+	for (int i = 0; i < n; i++) {
+		int p = parents[i];
+		if (p < 0) { continue; }
+		int classes[2];
+		int c = 0;
+		if (trunk[i] && trunk[p]) { classes[c++] = TRUNKBRANCHES; }
+		if (!trunk[i] && !trunk[p]) { 
+			classes[c++] = SIDEBRANCHES; 
+			if (!leaf[i]) { classes[c++] = INTERNALBRANCHES; }
+		}
+		sqDists[ALLBRANCHES] += sq[i];
+		dists[ALLBRANCHES] += dx[i];
+		times[ALLBRANCHES] += dt[i];
+		for (int k = 0; k < c; k++) {
+			sqDists[classes[k]] += sq[i];
+			dists[classes[k]] += dx[i];
+			times[classes[k]] += dt[i];
 		}
 	}
-	
-	rate /= count;		
-	rate = totalDist / totalTime;	
-	return rate;
 
 }
 
@@ -2735,14 +2878,154 @@ double CoalescentTree::timeToTrunk(string name) {
 
 }
 
+/* called after any change to the tree, cached aggregates and masks no longer hold */
+void CoalescentTree::modified() {
+	aggregated = false;
+	maskcache.clear();
+}
+
+/* gathers basic statistics in a single pass, these are kept until the tree is next modified */
+/* present and root time check the first node and every leaf, as leaves are nodes without children */
+/* labels are indexed in order of first appearance, migration counts are indexed [from * L + to] */
+void CoalescentTree::aggregate() {
+
+	vector<tree<Node>::iterator> nodes;
+	vector<int> parents;
+	flatten(nodes, parents);
+
+	presentTime = (*nodetree.begin()).getTime();
+	rootTime = (*nodetree.begin()).getTime();
+	nodeCount = nodes.size();
+	tipCount = 0;
+	leafCount = 0;
+	totalLength = 0.0;
+	coalTotal = 0;
+	migTotal = 0;
+	labelIndex.clear();
+	labelLengths.clear();
+	coalCounts.clear();
+	
+	vector<int> labels (nodes.size(), 0);
+	for (int i = 0; i < nodes.size(); i++) {
+		string l = (*nodes[i]).getLabel();
+		if (labelIndex.find(l) == labelIndex.end()) {
+			int n = labelIndex.size();
+			labelIndex[l] = n;
+		}
+		labels[i] = labelIndex[l];
+	}
+	
+	int L = labelIndex.size();
+	labelLengths.resize(L, 0.0);
+	coalCounts.resize(L, 0);
+	migCounts.assign(L * L, 0);
+	
+	for (int i = 0; i < nodes.size(); i++) {
+		tree<Node>::iterator it = nodes[i];
+		int children = nodetree.number_of_children(it);
+		if (children == 0) {
+			tipCount++;
+			if ((*it).getTime() > presentTime) { presentTime = (*it).getTime(); }
+			if ((*it).getTime() < rootTime) { rootTime = (*it).getTime(); }
+		}
+		if ( (*it).getLeaf() ) {
+			leafCount++;
+		}
+		if ( (*it).getInclude() ) {
+			totalLength += (*it).getLength();
+			labelLengths[labels[i]] += (*it).getLength();
+			if (children == 2) {
+				coalTotal++;
+				coalCounts[labels[i]]++;
+			}
+			int j = parents[i];
+			if (j >= 0 && (*nodes[j]).getInclude() && labels[i] != labels[j]) {
+				migTotal++;
+				migCounts[labels[j] * L + labels[i]]++;
+			}
+		}
+	}
+	
+	aggregated = true;
+
+}
+
+/* returns index of label in aggregates, -1 if label is not in tree */
+int CoalescentTree::findLabel(string l) {
+	map<string,int>::iterator mt = labelIndex.find(l);
+	if (mt == labelIndex.end()) {
+		return -1;
+	}
+	return mt->second;
+}
+
+/* lists nodes in preorder, along with the preorder position of each parent */
+/* keeps the current path from the top of the tree on a stack, so this is linear in tree size */
+void CoalescentTree::flatten(vector<tree<Node>::iterator> &nodes, vector<int> &parents) {
+
+	nodes.clear();
+	parents.clear();
+	vector<int> path;
+	
+	for (tree<Node>::iterator it = nodetree.begin(); it != nodetree.end(); ++it) {
+		tree<Node>::iterator jt = nodetree.parent(it);
+		while (path.size() > 0 && nodes[path.back()] != jt) {
+			path.pop_back();
+		}
+		if (path.size() > 0) {
+			parents.push_back(path.back());
+		}
+		else {
+			parents.push_back(-1);
+		}
+		path.push_back(nodes.size());
+		nodes.push_back(it);
+	}
+
+}
+
+/* erases every node that is neither a tip selected by mask nor an ancestor of one */
+void CoalescentTree::eraseUnmasked(Mask mask) {
+
+	vector<tree<Node>::iterator> nodes;
+	vector<int> parents;
+	flatten(nodes, parents);
+	
+	if (mask.size() != nodes.size()) {
+		throw runtime_error("Mask does not match tree");
+	}
+	
+	/* keep selected tips, then sweep back through preorder passing keep up to parents */
+	vector<char> keep (nodes.size(), false);
+	for (int i = nodes.size() - 1; i >= 0; i--) {
+		if ( mask.get(i) && (*nodes[i]).getLeaf() ) {
+			keep[i] = true;
+		}
+		if (keep[i] && parents[i] >= 0) {
+			keep[parents[i]] = true;
+		}
+	}
+	
+	/* erase the topmost unkept nodes, taking their subtrees with them */
+	for (int i = 0; i < nodes.size(); i++) {
+		if ( !keep[i] && (parents[i] < 0 || keep[parents[i]]) ) {
+			nodetree.erase(nodes[i]);
+		}
+	}
+
+}
+
 /* removes extraneous nodes from tree */
 void CoalescentTree::reduce() {
 
-	tree<Node>::iterator it, jt, kt;
+	tree<Node>::iterator it, jt, kt, nt;
 
 	/* removing pointless nodes, ie nodes that have no coalecent
 	events or migration events associated with them */
-	for (it = nodetree.begin(); it != nodetree.end(); ++it) {
+	/* merging a node moves its child to the end of the parent's children, the traversal carries on */
+	/* from the node's next sibling, or from the child if there is none */
+	it = nodetree.begin();
+	while (it != nodetree.end()) {
 		jt = nodetree.parent(it);
 		if (nodetree.is_valid(jt)) {
 			if (nodetree.number_of_children(it) == 1) {								// no coalescence	
@@ -2750,12 +3033,18 @@ void CoalescentTree::reduce() {
 				if ((*kt).getLabel() == (*it).getLabel()) { 						// mo migration
 	//				cout << "it = " << *it << ", kt = " << *kt << endl;
 					(*kt).setLength( (*kt).getLength() + (*it).getLength() );	
+					nt = nodetree.next_sibling(it);
+					if (!nodetree.is_valid(nt)) {
+						nt = kt;
+					}
 					nodetree.reparent(jt,it);										// push child node up to be sibling of node
 					nodetree.erase(it);												// erase node									
-					it = nodetree.begin();
+					it = nt;
+					continue;
 				}
 			}
 		}
+		++it;
 	}
 
 }
@@ -2792,21 +3081,51 @@ void CoalescentTree::peelBack() {
 void CoalescentTree::adjustCoords() {
 
 	tree<Node>::iterator it, jt;
+	vector<tree<Node>::iterator> nodes;
+	vector<int> parents, sizes, tips, next;
+	layout(nodes, parents, sizes, tips, next);
 
 	/* reorder tree so that the bottom node of two sister nodes always has the most recent child more children */
 	/* this combined with preorder traversal will insure the trunk follows a rough diagonal */
-	it = nodetree.begin();
-	while(it != nodetree.end()) {
-		jt = nodetree.next_sibling(it);
-		if (nodetree.is_valid(jt)) {
-			int cit = nodetree.size(it);
-			int cjt = nodetree.size(jt);
-			if (cit > cjt) {
-				nodetree.swap(jt,it);
-				it = nodetree.begin();
+	/* siblings are sorted by number of nodes below them, smallest first, with ties left in place */
+	/* the first node in the tree is only ever compared to its next sibling once, so at the top level */
+	/* the first two are swapped if need be and the rest sorted after the first */
+	vector<char> follows (nodes.size(), false);
+	for (int i = 0; i < nodes.size(); i++) {
+		if (next[i] >= 0) {
+			follows[next[i]] = true;
+		}
+	}
+	for (int i = 0; i < nodes.size(); i++) {
+		if (!follows[i] && next[i] >= 0) {
+		
+			vector<int> siblings;
+			int fixed = 0;
+			for (int j = i; j >= 0; j = next[j]) {
+				siblings.push_back(j);
+			}
+			if (parents[i] < 0) {
+				if (sizes[siblings[0]] > sizes[siblings[1]]) {
+					siblings[0] = siblings[1];
+					siblings[1] = i;
+				}
+				fixed = 1;
 			}
+			for (int j = fixed + 1; j < siblings.size(); j++) {
+				int k = j;
+				int m = siblings[j];
+				while (k > fixed && sizes[siblings[k-1]] > sizes[m]) {
+					siblings[k] = siblings[k-1];
+					k--;
+				}
+				siblings[k] = m;
+			}
+			
+			for (int k = 1; k < siblings.size(); k++) {
+				nodetree.move_after(nodes[siblings[k-1]],nodes[siblings[k]]);
+			}
+			
 		}
-		++it;
 	}
 
 	/* set coords of tips according to preorder traversal */
@@ -2839,7 +3158,10 @@ void CoalescentTree::adjustCoords() {
   			avg /= (double) childcount;
   			(*post_it).setYCoord(avg);
   		}
-	}	
+	}
+
+	// sibling order may have changed
+	modified();
 
 }	
 
@@ -2847,6 +3169,9 @@ void CoalescentTree::adjustCoords() {
 void CoalescentTree::adjustCircularCoords() {
 
 	tree<Node>::iterator it, jt;	
+	vector<tree<Node>::iterator> nodes;
+	vector<int> parents, sizes, tips, next;
+	layout(nodes, parents, sizes, tips, next);
 
 	// start at root, it has coordinate {0,0}
 	it = nodetree.begin();
@@ -2859,29 +3184,30 @@ void CoalescentTree::adjustCircularCoords() {
 	}
 	double angleForEachTip = 6.28318531 / numberOfTips;
 			
-	while(it != nodetree.end()) {
-		jt = nodetree.next_sibling(it);
-		if (nodetree.is_valid(jt)) {		// it left sibling and jt is right sibling
+	for (int i = 0; i < nodes.size(); i++) {
+		if (next[i] >= 0) {		// it left sibling and jt is right sibling
+		
+			it = nodes[i];
+			jt = nodes[next[i]];
 		
 			double basis = 0;
 			double parentX = 0;
 			double parentY = 0;			
-			tree<Node>::iterator pt = nodetree.parent(it);
-			tree<Node>::iterator ppt = nodetree.parent(pt);
-			if (nodetree.is_valid(pt)) { 	
-				parentX = (*pt).getXCoord();	
-				parentY = (*pt).getYCoord();					
+			int p = parents[i];
+			if (p >= 0) { 	
+				parentX = (*nodes[p]).getXCoord();	
+				parentY = (*nodes[p]).getYCoord();					
 			}
-			if (nodetree.is_valid(pt) && nodetree.is_valid(ppt)) { 
-				double deltaX = (*pt).getXCoord() - (*ppt).getXCoord();
-				double deltaY = (*pt).getYCoord() - (*ppt).getYCoord();
+			if (p >= 0 && parents[p] >= 0) { 
+				double deltaX = (*nodes[p]).getXCoord() - (*nodes[parents[p]]).getXCoord();
+				double deltaY = (*nodes[p]).getYCoord() - (*nodes[parents[p]]).getYCoord();
 				if (deltaX != 0) {
 					basis = atan2(deltaY,deltaX);
 				}
 			}
 		
-			double leftSector = angleForEachTip * (double) countDescendants(it);
-			double rightSector = angleForEachTip * (double) countDescendants(jt);			
+			double leftSector = angleForEachTip * (double) tips[i];
+			double rightSector = angleForEachTip * (double) tips[next[i]];			
 			double totalSector = leftSector + rightSector;
 			double leftAngle = basis + 0.5*totalSector - 0.5*leftSector; 
 			double rightAngle = basis - 0.5*totalSector + 0.5*rightSector; 			
@@ -2897,36 +3223,64 @@ void CoalescentTree::adjustCircularCoords() {
 			
 		}
 		// else, it is right sibling, do nothing						
-		++it;
 	}
 
+	// sibling order may have changed
+	modified();
 
 }
 
-// count tip descendended from a node
-int CoalescentTree::countDescendants(tree<Node>::iterator top) {
-	int descendants = 0;
-   	tree<Node>::pre_order_iterator it=top, eit=top;
-   	eit.skip_children();
-   	++eit;
-   	while (it!=eit) {
-   		if ((*it).getLeaf()) {
-      		++descendants;
-      	}
-      	++it;
-    }
-	return descendants;
+/* flattens tree in preorder along with the number of nodes and leaves below each node, and the */
+/* position of the next sibling of each node, -1 for the last, in a single sweep back through preorder */
+void CoalescentTree::layout(vector<tree<Node>::iterator> &nodes, vector<int> &parents, vector<int> &sizes, vector<int> &tips,
+	vector<int> &next) {
+
+	flatten(nodes, parents);
+	
+	int n = nodes.size();
+	sizes.assign(n, 1);
+	tips.assign(n, 0);
+	next.assign(n, -1);
+	
+	/* going back through preorder, siblings are seen last to first */
+	vector<int> seen (n + 1, -1);				// last sibling seen below each node, top level at n
+	for (int i = n - 1; i >= 0; i--) {
+		if ((*nodes[i]).getLeaf()) {
+			tips[i]++;
+		}
+		int p = parents[i];
+		int slot = n;
+		if (p >= 0) {
+			slot = p;
+			sizes[p] += sizes[i];
+			tips[p] += tips[i];
+		}
+		next[i] = seen[slot];
+		seen[slot] = i;
+	}
+
 }
 
 /* Setting tip coordinates based on input vector of tip names */
 void CoalescentTree::setCoords(vector<string> tipOrdering) {
 
 	tree<Node>::iterator it, jt;
+	vector<tree<Node>::iterator> nodes;
+	vector<int> parents, sizes, tips, next;
+	layout(nodes, parents, sizes, tips, next);
+	
+	/* names are looked up once, the first node with a name is used as findNode would */
+	map<string,int> named;
+	for (int i = nodes.size() - 1; i >= 0; i--) {
+		named[(*nodes[i]).getName()] = i;
+	}
 
 	/* set coords of tips according to supplied vector of names */
   	for (int i = 0; i < tipOrdering.size(); i++) {
-  		it = findNode(tipOrdering[i]);
-  		(*it).setYCoord(i);
+  		map<string,int>::iterator mt = named.find(tipOrdering[i]);
+  		if (mt != named.end()) {
+  			(*nodes[mt->second]).setYCoord(i);
+  		}
   	}
   		
 	/* revise coords of internal nodes according to postorder traversal */
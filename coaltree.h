@@ -22,6 +22,12 @@ You should have received a copy of the GNU General Public License along with PAC
 #ifndef CTREE_H
 #define CTREE_H
 
+#include <map>
+using std::map;
+
+#include <ostream>
+using std::ostream;
+
 #include <set>
 using std::set;
 
@@ -34,14 +40,29 @@ using std::vector;
 #include "tree.hh"
 #include "node.h"
 #include "rng.h"
+#include "mask.h"
+#include "annotation.h"
+#include "scanner.h"
+#include "splitter.h"
 
 class CoalescentTree {
 
+	friend class TreeView;					// views read nodetree directly
+
 public:
-	CoalescentTree(string);					// constructor, takes a parentheses string as input
+	enum BranchClass { ALLBRANCHES, TRUNKBRANCHES, SIDEBRANCHES, INTERNALBRANCHES };	// trunk branches have
+											// trunk at both ends, side branches at neither, and internal
+											// branches are side branches not ending in a leaf
+
+	CoalescentTree(Scanner &,map<string,int> &,vector<string> &);	// constructor, reads a parentheses
+											// string from scanner, along with the roles each annotation key
+											// is mapped to and the keys of discrete traits beyond the label, in order
 											// starts with most recent sample set at time = 0
 											// sharing a most recent sample time ensures skyline calculations 
 											// will work properly
+	CoalescentTree(Splitter &,map<string,int> &,vector<string> &);	// constructor, reads the tree found
+											// by splitter, parsing its subtrees on separate threads, with nodes 
+											// numbered as if read in order
 
 	// TREE MANIPULATION
 	void pushTimesBack(double);				// push dates to agree with a most recent sample date at t
@@ -57,6 +78,8 @@ public:
 	void pruneToTime(double,double);		// reduces CoalescentTree object to only include tips in a certain time frame
 	void padMigrationEvents();				// pads ancestral state tree with migration events
 	void collapseLabels();					// sets all labels in CoalescentTree to 1
+	void selectDiscrete(int);				// labels are read from discrete trait, 0 is the label as read
+											// and further traits are numbered from 1
 	void trimEnds(double,double);			// reduces CoalescentTree object to only those nodes between
 											// time start and time stop	
 	void sectionTree(double,double,double);	// break tree up into sections
@@ -70,6 +93,16 @@ public:
 	void accumulateLoc();					// accumulate X&Y traits across tree (converts branch displacements to node traits)	
 	void addTail(double);					// pads the tree with a node before the root, set backing by a specified amount of time	
 	void setCoords(vector<string>);			// sets coords based on supplied vector of tip names	
+	void pruneToMask(Mask);					// reduces tree to tips selected by mask and their ancestors
+
+	// TIP MASKS
+	// masks select tips by preorder position, and are cached until the tree is next modified
+	Mask getLabelMask(string);				// tips with label
+	Mask getTipsMask(vector<string>);		// named tips
+	Mask getTimeMask(double,double);		// tips between start and stop
+	Mask getTrunkMask();					// tips on trunk
+	Mask getNameMask(string);				// nodes with name
+	Mask getRandomMask(double);				// each tip selected with probability, not cached
 
 	// TREE STRUCTURE
 	void printTree();						// print indented tree with coalescent times			
@@ -77,8 +110,13 @@ public:
 											// used with Graphics primitives, specify whether linear or circular
 	void printRuleListWithOrdering(string,vector<string>);	// print to file name in Mathematica rule list format
 											// supply the tip ordering with vector of tip names											
+	void printRuleList(ostream &,bool);		// print to stream, as above
+	void printRuleListWithOrdering(ostream &,vector<string>);
 	void printParen();						// TODO: migration events
 											// print parentheses tree										
+	void printNewick(string &);				// appends tree in annotated NEWICK format, as read from BEAST, with
+											// states, rate and antigenic location of every node, migration
+											// events are nodes with a single child
 
 	// BASIC STATISTICS
 	double getPresentTime();				// returns most recent time in tree
@@ -95,8 +133,13 @@ public:
 	double getRootLabelPro(string);			// return proportion of root (0 or 1) with label	
 	double getTrunkPro();					// proportion of tree that can trace its history from present day samples
 	set<string> getLabelSet();				// return labelset
+	int getDiscreteCount();					// count of discrete traits, counting the label as read
+	map<string,Annotation::Type> getAnnotationTypes();	// type of every annotation key read, used or not
 	double getLabelProFromTips(string,double);		// return proportion of tree with label	at time back from tips
 	double getLabelProFromTips(string,double,string); // return proportion of tree with label conditioned on tip label
+	vector<double> getLabelProHistoryFromTips(vector<string>,vector<double>);	// proportions conditioned on tip label
+											// for every starting label, ending label and time back from tips,
+											// indexed [(start * L + end) * T + time]
 	
 	// COALESCENT STATISTICS
 	// problem with weight calculation for sectioned data
@@ -135,6 +178,7 @@ public:
 	vector<double> getTipsX();				// returns a vector of double for X position of every tip in tree
 	vector<double> getTipsY();				// returns a vector of double for Y position of every tip in tree	
 	void assignLocation();
+	int getDimensions();					// count of trait dimensions, x and y and any beyond them
 	double getDiffusionCoefficient();		// returns the coefficient of diffusion across the tree
 	double getDiffusionCoefficientTrunk();
 	double getDiffusionCoefficientSideBranches();		
@@ -143,6 +187,9 @@ public:
 	double getDriftRateTrunk();
 	double getDriftRateSideBranches();
 	double getDriftRateInternalBranches();
+	void sumBranches(vector<double> &, vector<double> &, vector<double> &);	// squared displacement, x 
+											// displacement and time, summed in a single pass over all, trunk,
+											// side and internal branches, indexed by BranchClass
 
 	tree<Node>::iterator getNodeBackFromTip(tree<Node>::iterator, double);													
 	double getXBackFromTip(tree<Node>::iterator, double);	
@@ -165,14 +212,65 @@ private:
 	RNG rgen;								// random number generator
 	tree<Node> nodetree;					// linked tree containing Node objects	
 	set<string> labelset;					// set of all label names
+	int dimensions;							// most trait dimensions held by any node, at least two
+	vector< set<string> > discreteSets;		// label sets of discrete traits not selected
+	int discrete;							// discrete trait held in labels
+	map<string,Annotation::Type> annotationTypes;	// every annotation key, typed by its first value
+	vector<Annotation> annotations;			// columns kept for output, other annotations are only held 
+											// in the labels, traits and rates they are mapped to
+	bool part;								// subtree read apart, whose kept values wait to be grafted
+	vector<string> keptKeys;				// keys of kept values of a part
+	vector<int> keptRows;					// kept values of a part, in the order they were read
+	vector<int> keptKeyIndex;				// into keptKeys
+	vector<int> keptEnds;					// ends of values, held one after another in keptText
+	string keptText;
+	map<string,Mask> maskcache;				// masks computed since the tree was last modified
+	
+	// AGGREGATES
+	// gathered together on first use, and kept until the tree is next modified
+	bool aggregated;
+	double presentTime;
+	double rootTime;
+	int nodeCount;
+	int tipCount;							// nodes without children
+	int leafCount;							// nodes flagged as leaves
+	double totalLength;
+	int coalTotal;
+	int migTotal;
+	map<string,int> labelIndex;				// labels in order of first appearance
+	vector<double> labelLengths;
+	vector<int> coalCounts;
+	vector<int> migCounts;					// L x L, indexed [from * L + to]
 										
 	// HELPER FUNCTIONS
+	void start(int);						// empty tree of a single root, with room for discrete traits
+	void parse(Scanner &, map<string,int> &, vector<string> &, Splitter *, vector<CoalescentTree> *);
+											// reads nodes below the root, grafting parts where splitter found them
+	int graft(tree<Node>::iterator, CoalescentTree &, int);	// moves nodes of part below node, numbering
+											// them on from offset, and returns count moved
+	void settle();							// times, trunk and most recent sample at time = 0, once read
 	string initialDigits(string);			// return initial digits in a string, 34ATZ -> 34, 3454 -> 0
+	void annotate(tree<Node>::iterator, string, string, int, int);	// passes value of key to its roles,
+											// the last naming its discrete trait
+	void setTraits(tree<Node>::iterator, vector<double> &);	// sets x, y and dimensions beyond them
+	void modified();						// called after any change to the tree, clears cached aggregates and masks
+	void aggregate();						// times, counts and lengths in a single pass
+	int findLabel(string);					// returns index of label in aggregates, -1 if not in tree
+	void appendNode(string &, tree<Node>::iterator);	// appends name, annotation and length of node
+	void appendNumber(string &, double);	// appends number to string without building a stream
+	void flatten(vector<tree<Node>::iterator> &, vector<int> &);	// lists nodes in preorder along with 
+											// the preorder position of each parent, -1 at top level
+	void eraseUnmasked(Mask);				// erases nodes that are neither selected tips nor their ancestors
+	void trimFrom(tree<Node>::iterator, tree<Node>::iterator, double, double, bool,
+		vector<tree<Node>::iterator> &, vector<tree<Node>::iterator> &);	// trims nodes in preorder, as
+											// trimEnds would in restarting after every change
 	void reduce();							// goes through tree and removes inconsequential nodes	
 	void peelBack();						// removes excess root from tree
 	void adjustCoords();					// sets coords in Nodes to allow tree drawing	
 	void adjustCircularCoords();			// sets coords in Nodes to allow tree unrooted drawing	
-	int countDescendants(tree<Node>::iterator);		// counts the number of tips descended from a node
+	void layout(vector<tree<Node>::iterator> &, vector<int> &, vector<int> &, vector<int> &, vector<int> &);
+											// lists nodes in preorder with parents, subtree sizes, leaves
+											// below and next siblings
 	int getMaxNumber();						// return largest number in tree
 	int renumber(int);						// renumbers tree in preorder traversal starting from int 
 											// returning 1 greater than the max in the tree
@@ -26,6 +26,7 @@ using std::ofstream;
 using std::cout;
 using std::endl;
 using std::ios;
+using std::streamoff;
 using std::unitbuf;
 using std::stringstream;
 
@@ -43,12 +44,44 @@ using std::vector;
 using std::set;
 using std::multiset;
 
+#include <map>
+using std::map;
+
 #include <cmath>
 using std::abs;
 
+#include <algorithm>
+using std::sort;
+
+#include <utility>
+using std::pair;
+
+#include <cstdio>
+using std::remove;
+
+#include <thread>
+#include <chrono>
+namespace this_thread = std::this_thread;
+namespace chrono = std::chrono;
+
 #include "io.h"
 #include "coaltree.h"
+#include "annotation.h"
+#include "treeview.h"
+#include "mask.h"
+#include "summary.h"
+#include "planner.h"
+#include "rulewriter.h"
+#include "newickwriter.h"
+#include "sink.h"
 #include "series.h"
+#include "rng.h"
+#include "scanner.h"
+#include "splitter.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 IO::IO() {
 
@@ -57,97 +90,90 @@ IO::IO() {
 	param.print();
 
 	// TREE INPUT /////////////////////
-	inputFile = "in.trees";
-	cout << "Reading trees from in.trees" << endl;
+	// in.trees, or the tree file of every chain named in in.param
+	if (param.chain) {
+		inputFiles = param.chain_files;
+	}
+	else {
+		inputFiles.push_back("in.trees");
+	}
 	
-	ifstream inStream;
-	inStream.open( inputFile.c_str(),ios::out);
-
-	string line;
-	int pos;
-	int treesread = 0;
-	if (inStream.is_open()) {
-		while (! inStream.eof() ) {
-			getline (inStream,line);
-			
-			if (line.size() > 0) {
-				if (line[0] != '#') {
-			
-					// Catching log probabilities of trees
-					string annoString;
-					
-					// migrate annotation
-					annoString = "ln(L) = ";
-					pos = line.find(annoString);
-		
-					if (pos >= 0) {
-						string thisString;
-						thisString = line.substr(pos+annoString.size());
-						thisString.erase(thisString.find(' '));
-						double ll = atof(thisString.c_str());
-						problist.push_back(ll);
-						line = "";								// ignore rest of line
-					}
-					
-					// beast annotation
-					annoString = "[&lnP=";
-					pos = line.find(annoString);
-		
-					if (pos >= 0) {
-						string thisString;
-						thisString = line.substr(pos+annoString.size());
-						thisString.erase(thisString.find(']'));
-						double ll = atof(thisString.c_str());
-						problist.push_back(ll);				
-					}
-					
-					// find first occurance of '(' in line
-					pos = line.find('(');
-					if (pos >= 0) {
-					
-						// if burnin has finished
-						if (param.burnin) {
-							if ( treesread > (param.burnin_values)[0] ) {
-						
-								string paren = line.substr(pos);
-								CoalescentTree ct(paren);
-								treelist.push_back(ct);
-						//		cout << "tree " << treelist.size() + (param.burnin_values)[0] << " read" << endl;
-								cout << unitbuf << ".";
-						
-							}
-						
-						}
-						
-						else {
-
-							string paren = line.substr(pos);
-							CoalescentTree ct(paren);
-							treelist.push_back(ct);	
-						//	cout << "tree " << treelist.size() << " read" << endl;		
-							cout << unitbuf << ".";
-						
-						}
-						
-						treesread++;
-							
-					}
-
-				}
-			}			
+	// ANNOTATION ROLES /////////////
+	// keys named in in.param replace the default roles
+	// discrete traits beyond the label are numbered in the order they are named
+	roles = Annotation::defaultRoles();
+	set<string> named;
+	for (int i = 0; i < param.annotation_keys.size(); i++) {
+		string key = param.annotation_keys[i];
+		int role = Annotation::parseRole(param.annotation_roles[i]);
+		if (role < 0) {
+			throw runtime_error("unknown annotation role " + param.annotation_roles[i] + " in in.param");
 		}
-		inStream.close();
+		if (named.count(key) == 0) {
+			roles[key] = 0;
+			named.insert(key);
+		}
+		if (role == Annotation::DISCRETE && (roles[key] & role) == 0) {
+			discreteKeys.push_back(key);
+		}
+		roles[key] |= role;
 	}
-	else {
-		throw runtime_error("tree file in.trees not found");
+	
+	// roles that nothing reads are dropped, so that their annotations are passed over unparsed
+	int unread = 0;
+	if (!param.traits()) { unread |= Annotation::X | Annotation::Y | Annotation::TRAIT; }
+	if (!param.rates()) { unread |= Annotation::RATE; }
+	for (map<string,int>::iterator ir = roles.begin(); ir != roles.end(); ++ir) {
+		(*ir).second &= ~unread;
 	}
 	
-	cout << endl;
+	// INDEX OF TREES ////////////////
+	// lines are scanned for log probabilities and the offset of each tree, but trees are not parsed
+	// until they are first used; chains are indexed in turn and pooled in the order they are named
+	if (param.follow && param.subsample) {
+		throw runtime_error("follow cannot be used with subsample");
+	}
+	chainEnds.assign(inputFiles.size(), 0);
+	chainTrees.assign(inputFiles.size(), 0);
+	chainCandidates.assign(inputFiles.size(), 0);
+	chainEnded.assign(inputFiles.size(), false);
+	probsComplete = true;
+	loaded = false;
+	manipulated = 0;
+	summarized = 0;
+	skylined = 0;
+	indexChains();
 	
-	if (treelist.size() == 0) {
+	if (inputFiles.size() > 1) {
+		cout << treeOffsets.size() << " trees pooled from " << inputFiles.size() << " chains" << endl;
+	}
+	
+	// while following, chains that are still in burnin are waited for
+	if (param.follow && treeOffsets.size() == 0) {
+		cout << "Waiting for trees" << endl;
+		while (treeOffsets.size() == 0) {
+			this_thread::sleep_for(chrono::seconds((int) (param.follow_values)[0]));
+			indexChains();
+		}
+	}
+	
+	if (treeOffsets.size() == 0) {
 		throw runtime_error("no suitable trees on which to perform analysis");
 	}
 	
+	// annotations of the first tree, with the roles they fill
+	map<string,Annotation::Type> types = getTree(0).getAnnotationTypes();
+	if (types.size() > 0) {
+		cout << "Annotations:" << endl;
+		for (map<string,Annotation::Type>::iterator ia = types.begin(); ia != types.end(); ++ia) {
+			map<string,int>::iterator ir = roles.find((*ia).first);
+			int role = 0;
+			if (ir != roles.end()) { role = (*ir).second; }
+			cout << (*ia).first << " (" << Annotation::describe((*ia).second, role) << ")" << endl;
+		}
+		cout << endl;
+	}
+	
 	// ZEROING OUTPUT FILES ///////////
 	// append from now on
 	// only zero files that will be used later
@@ -192,9 +218,11 @@ void IO::treeManip() {
 
 	if (param.manip()) {
 
+		loadTrees();
+
 		cout << "Performing tree manipulation operations"  << endl;
 		
-		for (int i = 0; i < treelist.size(); i++) {
+		for (int i = manipulated; i < treelist.size(); i++) {
 		
 			// PUSH TIMES BACK
 			if (param.push_times_back) {
@@ -242,32 +270,46 @@ void IO::treeManip() {
 				treelist[i].timeSlice(time);
 			}
 						
+			// PRUNES
+			// each prune selects tips, these are combined and the tree is reduced once
+			Mask mask (treelist[i].getNodeCount(), true);
+			bool prune = false;
+						
 			// PRUNE TO LABEL
 			if (param.prune_to_label) {
 				string label = (param.prune_to_label_values)[0];
-				treelist[i].pruneToLabel(label);
+				mask = mask & treelist[i].getLabelMask(label);
+				prune = true;
 			}	
 			
 			// PRUNE TO TIPS
 			if (param.prune_to_tips) {
-				treelist[i].pruneToTips(param.prune_to_tips_values);
+				mask = mask & treelist[i].getTipsMask(param.prune_to_tips_values);
+				prune = true;
 			}	
 			
 			// REMOVE TIPS
 			if (param.remove_tips) {
-				treelist[i].removeTips(param.remove_tips_values);
+				mask = mask & ~treelist[i].getTipsMask(param.remove_tips_values);
+				prune = true;
 			}							
 			
 			// PRUNE TO TRUNK
 			if (param.prune_to_trunk) {
-				treelist[i].pruneToTrunk();
+				mask = mask & treelist[i].getTrunkMask();
+				prune = true;
 			}	
 
 			// PRUNE TO TIME
 			if (param.prune_to_time) {
 				double start = (param.prune_to_time_values)[0];
 				double stop = (param.prune_to_time_values)[1];
-				treelist[i].pruneToTime(start,stop);
+				mask = mask & treelist[i].getTimeMask(start,stop);
+				prune = true;
+			}
+			
+			if (prune) {
+				treelist[i].pruneToMask(mask);
 			}				
 
 			// PAD MIGRATION EVENTS
@@ -303,6 +345,7 @@ void IO::treeManip() {
 			}				
 		
 		}
+		manipulated = treelist.size();
 
 	}
 
@@ -315,46 +358,56 @@ void IO::printTree() {
 
 		string outputFile = outputPrefix + ".rules";
 		cout << "Printing tree with highest posterior probability to " << outputFile << endl;		
-		int index = getBestTree();
+		CoalescentTree &best = getTree(getBestTree());
 		
 		if (!param.ordering && !param.print_circular_tree) {
-			treelist[index].printRuleList(outputFile, false);
+			best.printRuleList(outputFile, false);
 		}
 		else if (param.ordering && !param.print_circular_tree) {
-			treelist[index].printRuleListWithOrdering(outputFile,param.ordering_values);
+			best.printRuleListWithOrdering(outputFile,param.ordering_values);
 		}
 		else if (!param.ordering && param.print_circular_tree) {
-			treelist[index].printRuleList(outputFile, true);
+			best.printRuleList(outputFile, true);
 		}		
 		
 	}
 
+	if (param.print_all_trees || param.print_newick || param.print_nexus) {
+		loadTrees();
+	}
+
 	if (param.print_all_trees) {
 
-		cout << "Printing trees with to trees/ directory" << endl;
+		RuleWriter writer (outputPrefix, param.print_all_trees_archive);
+		if (param.print_all_trees_archive) {
+			cout << "Printing trees to " << outputPrefix << ".archive" << endl;
+		}
+		else {
+			cout << "Printing trees with to trees/ directory" << endl;
+		}
 		
-		for (int i = 0; i < treelist.size(); i++) {
-
-			stringstream ss;
-			ss << i;
-			string outputFile = "trees/" + outputPrefix + "_" + ss.str() + ".rules";
-			
-			ofstream outStream;
-			outStream.open( outputFile.c_str(),ios::out);
-			outStream.close();
-			
-			CoalescentTree ct = treelist[i];
-					
-			if (!param.ordering) {
-				ct.printRuleList(outputFile, false);
-			}
-			else {
-				ct.printRuleListWithOrdering(outputFile,param.ordering_values);
-			}			
-			
+		if (!param.ordering) {
+			writer.write(treelist);
+		}
+		else {
+			writer.write(treelist, param.ordering_values);
 		}
 			
 	}
+	
+	if (param.print_newick) {
+		string outputFile = outputPrefix + ".newick";
+		cout << "Printing trees in NEWICK format to " << outputFile << endl;
+		NewickWriter writer (outputFile, false);
+		writer.write(treelist, problist);
+	}
+	
+	if (param.print_nexus) {
+		string outputFile = outputPrefix + ".nexus";
+		cout << "Printing trees in NEXUS format to " << outputFile << endl;
+		NewickWriter writer (outputFile, true);
+		writer.write(treelist, problist);
+	}
 
 
 }
@@ -364,381 +417,336 @@ void IO::printStatistics() {
 
 	if (param.summary()) {
 
+		loadTrees();
+
 		/* initializing output stream */
 		string outputFile = outputPrefix + ".stats";
-		ofstream outStream;
-		outStream.open( outputFile.c_str(),ios::app);
+		string tableFile = "";
+		if (param.output_columns) { 
+			tableFile = outputFile + ".bin";
+			cout << "Printing summary table to " << tableFile << endl; 
+		}
+		Sink outStream (outputFile, tableFile);
 		
-		outStream << "statistic\tlower\tmean\tupper" << endl; 
+		outStream << "statistic\tlower\tmean\tupper\n"; 
 		
 		set<string>::const_iterator is;
 		set<string>::const_iterator js;
 		set<string> lset = treelist[0].getLabelSet();		
+		vector< set<string> > dsets = getDiscreteSets();
+		
+		if (param.summary_tmrca) { cout << "Printing TMRCA summary to " << outputFile << endl; }
+		if (param.summary_length) { cout << "Printing length summary to " << outputFile << endl; }
+		if (param.summary_root_proportions) { cout << "Printing root proportion summary to " << outputFile << endl; }
+		if (param.summary_proportions) { cout << "Printing trunk proportion summary to " << outputFile << endl; }
+		if (param.summary_coal_rates) { cout << "Printing coalescent summary to " << outputFile << endl; }
+		if (param.summary_mig_rates) { cout << "Printing migration summary to " << outputFile << endl; }
+		if (param.summary_sub_rates) { cout << "Printing substitution rate summary to " << outputFile << endl; }
+		if (param.summary_diversity) { cout << "Printing diversity summary to " << outputFile << endl; }
+		if (param.summary_fst) { cout << "Printing FST summary to " << outputFile << endl; }
+		if (param.summary_tajima_d) { cout << "Printing Tajima's D summary to " << outputFile << endl; }
+		if (param.summary_persistence) { cout << "Printing persistence summary to " << outputFile << endl; }
+		if (param.summary_diffusion_coefficient) { cout << "Printing coefficients of diffusion to " << outputFile << endl; }
+		if (param.summary_drift_rate) { cout << "Printing drift rate to " << outputFile << endl; }
 		
-		// TMRCA  //////////////
-		if (param.summary_tmrca) {
-			cout << "Printing TMRCA summary to " << outputFile << endl;
-			Series s;
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getTMRCA();
-				s.insert(n);
+		/* every requested statistic is evaluated on a tree before moving to the next tree */
+		/* the view gathers the quantities that statistics share in as few passes as possible */
+		/* trees already in the summary are passed over, so that only trees appended while following are added */
+		TreeView view;
+		vector<double> sqDists, dists, times;
+		for (int i = summarized; i < treelist.size(); i++) {
+		
+			if (inputFiles.size() > 1) {
+				summary.nextTree(treeChains[i]);
 			}
-			outStream << "tmrca" << "\t";
-			outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-		}
+			else {
+				summary.nextTree();
+			}
+			view.attach(treelist[i]);
 		
-		// LENGTH  //////////////
-		if (param.summary_length) {
-			cout << "Printing length summary to " << outputFile << endl;
-			Series s;
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getLength();
-				s.insert(n);
+			// TMRCA  //////////////
+			if (param.summary_tmrca) {
+				summary.add("tmrca", view.getTMRCA());
 			}
-			outStream << "length" << "\t";
-			outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-		}		
+			
+			// LENGTH  //////////////
+			if (param.summary_length) {
+				summary.add("length", view.getLength());
+			}		
 
-		// ROOT PROPORTIONS //////////////
-		if (param.summary_root_proportions) {
-			cout << "Printing root proportion summary to " << outputFile << endl;
-			for (is = lset.begin(); is != lset.end(); ++is) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					double n = ct.getRootLabelPro(*is);
-					s.insert(n);
+			// ROOT PROPORTIONS //////////////
+			if (param.summary_root_proportions) {
+				for (is = lset.begin(); is != lset.end(); ++is) {
+					summary.add("rootpro_" + *is, treelist[i].getRootLabelPro(*is));
 				}
-				outStream << "rootpro_" << *is << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;		
 			}
-		}
 
-		// LABEL PROPORTIONS //////////////
-		if (param.summary_proportions) {
-			cout << "Printing trunk proportion summary to " << outputFile << endl;
-			for (is = lset.begin(); is != lset.end(); ++is) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					double n = ct.getLabelPro(*is);
-					s.insert(n);
+			// LABEL PROPORTIONS //////////////
+			if (param.summary_proportions) {
+				for (is = lset.begin(); is != lset.end(); ++is) {
+					summary.add("pro_" + *is, view.getLabelPro(*is));
 				}
-				outStream << "pro_" << *is << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;		
 			}
-		}
-	
-		// COALESCENCE /////////////////////
-		if (param.summary_coal_rates) {
-			cout << "Printing coalescent summary to " << outputFile << endl;	
-			if (lset.size()>1) {
-				for (is = lset.begin(); is != lset.end(); ++is) {
-					Series s;
-					for (int i = 0; i < treelist.size(); i++) {
-						double n = treelist[i].getCoalRate(*is);
-						s.insert(n);
+		
+			// COALESCENCE /////////////////////
+			if (param.summary_coal_rates) {
+				if (lset.size()>1) {
+					for (is = lset.begin(); is != lset.end(); ++is) {
+						summary.add("coal_" + *is, view.getCoalRate(*is));
 					}
-					outStream << "coal_" << *is << "\t";
-					outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
 				}
-			}
-			else {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					double n = treelist[i].getCoalRate();
-					s.insert(n);
+				else {
+					summary.add("coal", view.getCoalRate());
 				}
-				outStream << "coal\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
 			}
-		}
-		
-		// MIGRATION ///////////////////////
-		if (param.summary_mig_rates) {		
-			cout << "Printing migration summary to " << outputFile << endl;
 			
-			Series s;
-			for (int i = 0; i < treelist.size(); i++) {
-				double n = treelist[i].getMigRate();
-				s.insert(n);
-			}
-			outStream << "mig_all\t";
-			outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-						
-			for (is = lset.begin(); is != lset.end(); ++is) {
-				for (js = lset.begin(); js != lset.end(); ++js) {
-					string from = *is;
-					string to = *js;
-					if (from != to) {
-						Series s;
-						for (int i = 0; i < treelist.size(); i++) {
-							double n = treelist[i].getMigRate(from,to);
-							s.insert(n);
+			// MIGRATION ///////////////////////
+			if (param.summary_mig_rates) {		
+				summary.add("mig_all", view.getMigRate());
+				for (is = lset.begin(); is != lset.end(); ++is) {
+					for (js = lset.begin(); js != lset.end(); ++js) {
+						string from = *is;
+						string to = *js;
+						if (from != to) {
+							summary.add("mig_" + from + "_" + to, view.getMigRate(from,to));
 						}
-						outStream << "mig_" << from << "_" << to << "\t";
-						outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-		
-					}
-				}	
+					}	
+				}
 			}
-		}
 
-		// SUBS RATE  //////////////
-		if (param.summary_sub_rates) {
-			cout << "Printing substitution rate summary to " << outputFile << endl;
-			Series s;
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getMeanRate();
-				s.insert(n);
-			}
-			outStream << "subrate" << "\t";
-			outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-		}	
-
-		// DIVERSITY  //////////////
-		if (param.summary_diversity) {
-			cout << "Printing diversity summary to " << outputFile << endl;
-			if (lset.size()>1) {
-				for (is = lset.begin(); is != lset.end(); ++is) {
-					Series s;
-					for (int i = 0; i < treelist.size(); i++) {
-						double n = treelist[i].getDiversity(*is);
-						s.insert(n);
+			// SUBS RATE  //////////////
+			if (param.summary_sub_rates) {
+				summary.add("subrate", view.getMeanRate());
+			}	
+
+			// DIVERSITY  //////////////
+			if (param.summary_diversity) {
+				if (lset.size()>1) {
+					for (is = lset.begin(); is != lset.end(); ++is) {
+						summary.add("div_" + *is, view.getDiversity(*is));
 					}
-					outStream << "div_" << *is << "\t";
-					outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
 				}
-			}
-			else {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					double n = treelist[i].getDiversity();
-					s.insert(n);
+				else {
+					summary.add("div", view.getDiversity());
 				}
-				outStream << "div" << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-			}
-		}	
-		
-		// FST  //////////////
-		if (param.summary_fst) {
-			cout << "Printing FST summary to " << outputFile << endl;
-			Series s;
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getFst();
-				s.insert(n);
-			}
-			outStream << "fst" << "\t";
-			outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-		}	
-		
-		// TAJIMA'S D  //////////////
-		if (param.summary_tajima_d) {
-			cout << "Printing Tajima's D summary to " << outputFile << endl;
-			Series s;
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getTajimaD();
-				s.insert(n);
-			}
-			outStream << "tajimad" << "\t";
-			outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-		}			
-		
-		// PERSISTENCE ///////////////////////
-		if (param.summary_persistence) {		
-			cout << "Printing persistence summary to " << outputFile << endl;
+			}	
 			
-			Series s;
-			for (int i = 0; i < treelist.size(); i++) {
-				double n = treelist[i].getPersistence();
-				s.insert(n);
-			}
-			double avg = s.mean();
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				double n = treelist[i].getPersistenceQuantile(0.25);
-				s.insert(n);
-			}
-			double lower = s.mean();
-			s.clear();	
-			for (int i = 0; i < treelist.size(); i++) {
-				double n = treelist[i].getPersistenceQuantile(0.75);
-				s.insert(n);
-			}
-			double upper = s.mean();
-			s.clear();			
+			// FST  //////////////
+			if (param.summary_fst) {
+				summary.add("fst", view.getFst());
+			}	
 			
-			outStream << "persistence_all\t";
-			outStream << lower << "\t" << avg << "\t" << upper << endl;
-						
-			for (is = lset.begin(); is != lset.end(); ++is) {
-				string label = *is;
-
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					double n = treelist[i].getPersistence(label);
-					s.insert(n);
-				}
-				double avg = s.mean();
-				s.clear();
-				for (int i = 0; i < treelist.size(); i++) {
-					double n = treelist[i].getPersistenceQuantile(0.25, label);
-					s.insert(n);
-				}
-				double lower = s.mean();
-				s.clear();	
-				for (int i = 0; i < treelist.size(); i++) {
-					double n = treelist[i].getPersistenceQuantile(0.75, label);
-					s.insert(n);
+			// TAJIMA'S D  //////////////
+			if (param.summary_tajima_d) {
+				summary.add("tajimad", view.getTajimaD());
+			}			
+			
+			// PERSISTENCE ///////////////////////
+			// lower and upper are means across trees of within-tree quartiles
+			if (param.summary_persistence) {		
+				summary.addRange("persistence_all", view.getPersistenceQuantile(0.25), view.getPersistence(), view.getPersistenceQuantile(0.75));
+				for (is = lset.begin(); is != lset.end(); ++is) {
+					string label = *is;
+					summary.addRange("persistence_" + label, view.getPersistenceQuantile(0.25, label), view.getPersistence(label), view.getPersistenceQuantile(0.75, label));
 				}
-				double upper = s.mean();
-				s.clear();		
-
-				outStream << "persistence_" << label << "\t";
-				outStream << lower << "\t" << avg << "\t" << upper << endl;
+			}		
+			
+			// Diffusion coefficient and drift //////////////
+			// both come from the same totals over branches, gathered in a single pass
+			if (param.summary_diffusion_coefficient || param.summary_drift_rate) {
+				treelist[i].sumBranches(sqDists, dists, times);
 			}
-		}		
-		
-		// Diffusion coefficient  //////////////
-		if (param.summary_diffusion_coefficient) {
+			
+			if (param.summary_diffusion_coefficient) {
 
-			double lowerQuantile = 0.25;
-			double upperQuantile = 0.75;		
-		
-			cout << "Printing coefficients of diffusion to " << outputFile << endl;
-			Series s;
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDiffusionCoefficient();
-				s.insert(n);
-			}
-			outStream << "diffusionCoefficient" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;
+				double lowerQuantile = 0.25;
+				double upperQuantile = 0.75;		
+				double norm = 2.0 * treelist[i].getDimensions();
+				
+				double all = sqDists[CoalescentTree::ALLBRANCHES] / (norm * times[CoalescentTree::ALLBRANCHES]);
+				double trunk = sqDists[CoalescentTree::TRUNKBRANCHES] / (norm * times[CoalescentTree::TRUNKBRANCHES]);
+				double side = sqDists[CoalescentTree::SIDEBRANCHES] / (norm * times[CoalescentTree::SIDEBRANCHES]);
+				double internal = sqDists[CoalescentTree::INTERNALBRANCHES] / (norm * times[CoalescentTree::INTERNALBRANCHES]);
 			
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDiffusionCoefficientTrunk();
-				s.insert(n);
-			}
-			outStream << "diffusionCoefficientTrunk" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;
+				summary.add("diffusionCoefficient", all, lowerQuantile, upperQuantile);
+				summary.add("diffusionCoefficientTrunk", trunk, lowerQuantile, upperQuantile);
+				summary.add("diffusionCoefficientSideBranches", side, lowerQuantile, upperQuantile);
+				summary.add("diffusionCoefficientInternalBranches", internal, lowerQuantile, upperQuantile);
+				summary.add("diffusionCoefficientTSRatio", trunk / side, lowerQuantile, upperQuantile);
+				summary.add("diffusionCoefficientTIRatio", trunk / internal, lowerQuantile, upperQuantile);
+				
+			}	
 			
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDiffusionCoefficientSideBranches();
-				s.insert(n);
-			}
-			outStream << "diffusionCoefficientSideBranches" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;
+			// Drift   //////////////
+			if (param.summary_drift_rate) {
 			
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDiffusionCoefficientInternalBranches();
-				s.insert(n);
-			}
-			outStream << "diffusionCoefficientInternalBranches" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;			
-					
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDiffusionCoefficientTrunk();
-				double d = ct.getDiffusionCoefficientSideBranches();
-				s.insert(n/d);
+				double lowerQuantile = 0.25;
+				double upperQuantile = 0.75;
+				
+				double all = dists[CoalescentTree::ALLBRANCHES] / times[CoalescentTree::ALLBRANCHES];
+				double trunk = dists[CoalescentTree::TRUNKBRANCHES] / times[CoalescentTree::TRUNKBRANCHES];
+				double side = dists[CoalescentTree::SIDEBRANCHES] / times[CoalescentTree::SIDEBRANCHES];
+				double internal = dists[CoalescentTree::INTERNALBRANCHES] / times[CoalescentTree::INTERNALBRANCHES];
+			
+				summary.add("driftRate", all, lowerQuantile, upperQuantile);
+				summary.add("driftRateTrunk", trunk, lowerQuantile, upperQuantile);
+				summary.add("driftRateSideBranches", side, lowerQuantile, upperQuantile);
+				summary.add("driftRateInternalBranches", internal, lowerQuantile, upperQuantile);
+				summary.add("driftRateTSRatio", trunk / side, lowerQuantile, upperQuantile);
+				summary.add("driftRateTIRatio", trunk / internal, lowerQuantile, upperQuantile);
+				
 			}
-			outStream << "diffusionCoefficientTSRatio" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;		
 			
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDiffusionCoefficientTrunk();
-				double d = ct.getDiffusionCoefficientInternalBranches();
-				s.insert(n/d);
+			// FURTHER DISCRETE TRAITS ///////////////////////
+			// labels are exchanged with each trait in turn, reusing the attached view
+			for (int d = 1; d < dsets.size(); d++) {
+				treelist[i].selectDiscrete(d);
+				view.relabel();
+				addLabelSummaries(summary, view, treelist[i], dsets[d], discreteKeys[d-1]);
 			}
-			outStream << "diffusionCoefficientTIRatio" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;					
+			treelist[i].selectDiscrete(0);
 			
-		}	
+		}
+
+		summarized = treelist.size();
+
+		summary.print(outStream);
+		outStream.close();
+	
+	}
+
+}
+
+/* trees appended to the tree files are indexed, parsed and manipulated as they arrive, and are added */
+/* to summaries and skylines, which are rewritten in full after every check that finds new trees */
+void IO::follow() {
+
+	if (param.follow) {
+	
+		int interval = (int) (param.follow_values)[0];
+		int patience = -1;
+		if ((param.follow_values).size() == 2) { patience = (int) (param.follow_values)[1]; }
 		
-		// Drift   //////////////
-		if (param.summary_drift_rate) {
+		cout << "Following ";
+		for (int c = 0; c < inputFiles.size(); c++) {
+			cout << inputFiles[c] << " ";
+		}
+		cout << "every " << interval << " seconds" << endl;
 		
-			double lowerQuantile = 0.25;
-			double upperQuantile = 0.75;
+		int idle = 0;
+		while (patience < 0 || idle < patience) {
 		
-			cout << "Printing drift rate to " << outputFile << endl;
-			Series s;
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDriftRate();
-				s.insert(n);
+			bool ended = true;
+			for (int c = 0; c < inputFiles.size(); c++) {
+				if (!chainEnded[c]) { ended = false; }
 			}
-			outStream << "driftRate" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;
-			
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDriftRateTrunk();
-				s.insert(n);
+			if (ended) {
+				break;
 			}
-			outStream << "driftRateTrunk" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;
-			
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDriftRateSideBranches();
-				s.insert(n);
+		
+			this_thread::sleep_for(chrono::seconds(interval));
+			int added = indexChains();
+			if (added == 0) {
+				idle++;
+				continue;
 			}
-			outStream << "driftRateSideBranches" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;
+			idle = 0;
 			
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDriftRateInternalBranches();
-				s.insert(n);
+			// text sinks append, so files are removed before being written again
+			cout << added << " trees appended, " << treeOffsets.size() << " trees in all" << endl;
+			treeManip();
+			if (param.summary()) {
+				remove((outputPrefix + ".stats").c_str());
+				printStatistics();
 			}
-			outStream << "driftRateInternalBranches" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;		
-
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDriftRateTrunk();
-				double d = ct.getDriftRateSideBranches();
-				s.insert(n/d);
+			if (param.skyline() && !param.skyline_explain) {
+				remove((outputPrefix + ".skylines").c_str());
+				printSkylines();
 			}
-			outStream << "driftRateTSRatio" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;	
 			
-			s.clear();
-			for (int i = 0; i < treelist.size(); i++) {
-				CoalescentTree ct = treelist[i];
-				double n = ct.getDriftRateTrunk();
-				double d = ct.getDriftRateInternalBranches();
-				s.insert(n/d);
-			}
-			outStream << "driftRateTIRatio" << "\t";
-			outStream << s.quantile(lowerQuantile) << "\t" << s.mean() << "\t" << s.quantile(upperQuantile) << endl;					
-			
-		}			
+		}
+		
+		cout << "Stopped following after " << treeOffsets.size() << " trees" << endl;
+	
+	}
 
+}
 
-		outStream.close();
+/* label statistics of the discrete trait selected in tree and view, named after its key */
+void IO::addLabelSummaries(Summary &summary, TreeView &view, CoalescentTree &ct, set<string> &lset, string key) {
+
+	set<string>::const_iterator is;
+	set<string>::const_iterator js;
+	string prefix = key + "_";
+
+	// ROOT PROPORTIONS //////////////
+	if (param.summary_root_proportions) {
+		for (is = lset.begin(); is != lset.end(); ++is) {
+			summary.add(prefix + "rootpro_" + *is, ct.getRootLabelPro(*is));
+		}
+	}
+
+	// LABEL PROPORTIONS //////////////
+	if (param.summary_proportions) {
+		for (is = lset.begin(); is != lset.end(); ++is) {
+			summary.add(prefix + "pro_" + *is, view.getLabelPro(*is));
+		}
+	}
+
+	// COALESCENCE /////////////////////
+	if (param.summary_coal_rates) {
+		if (lset.size()>1) {
+			for (is = lset.begin(); is != lset.end(); ++is) {
+				summary.add(prefix + "coal_" + *is, view.getCoalRate(*is));
+			}
+		}
+		else {
+			summary.add(prefix + "coal", view.getCoalRate());
+		}
+	}
+	
+	// MIGRATION ///////////////////////
+	if (param.summary_mig_rates) {		
+		summary.add(prefix + "mig_all", view.getMigRate());
+		for (is = lset.begin(); is != lset.end(); ++is) {
+			for (js = lset.begin(); js != lset.end(); ++js) {
+				string from = *is;
+				string to = *js;
+				if (from != to) {
+					summary.add(prefix + "mig_" + from + "_" + to, view.getMigRate(from,to));
+				}
+			}	
+		}
+	}
+
+	// DIVERSITY  //////////////
+	if (param.summary_diversity && lset.size()>1) {
+		for (is = lset.begin(); is != lset.end(); ++is) {
+			summary.add(prefix + "div_" + *is, view.getDiversity(*is));
+		}
+	}	
 	
+	// PERSISTENCE ///////////////////////
+	if (param.summary_persistence) {		
+		summary.addRange(prefix + "persistence_all", view.getPersistenceQuantile(0.25), view.getPersistence(), view.getPersistenceQuantile(0.75));
+		for (is = lset.begin(); is != lset.end(); ++is) {
+			string label = *is;
+			summary.addRange(prefix + "persistence_" + label, view.getPersistenceQuantile(0.25, label), view.getPersistence(label), view.getPersistenceQuantile(0.75, label));
+		}
+	}		
+
+}
+
+/* labels of each discrete trait are read from the first tree, with the label as read first */
+vector< set<string> > IO::getDiscreteSets() {
+
+	vector< set<string> > dsets;
+	for (int d = 0; d < treelist[0].getDiscreteCount(); d++) {
+		treelist[0].selectDiscrete(d);
+		dsets.push_back(treelist[0].getLabelSet());
 	}
+	treelist[0].selectDiscrete(0);
+	return dsets;
 
 }
 
@@ -747,430 +755,315 @@ void IO::printSkylines() {
 
 	if (param.skyline()) {
 
-		/* initializing output stream */
+		loadTrees();
+
 		string outputFile = outputPrefix + ".skylines";
-		ofstream outStream;
-		outStream.open( outputFile.c_str(),ios::app);
 		
-		outStream << "statistic\ttime\tlower\tmean\tupper" << endl; 
+		/* the plan is built once and run on trees not yet evaluated, so that only trees appended */
+		/* while following are added */
+		if (skylined == 0) {
+			planSkylines(skylinePlan, outputFile);
+		}
+		Planner &plan = skylinePlan;
 		
-		set<string>::const_iterator is;
-		set<string>::const_iterator js;
-		set<string> lset = treelist[0].getLabelSet();	
-
-		double start = param.skyline_values[0];
-		double stop = param.skyline_values[1];
-		double step = param.skyline_values[2];
-
-		// TMRCA /////////////////////
-		if (param.skyline_tmrca) {
-			cout << "Printing TMRCA skyline to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t + step / (double) 2);
-					double n = ct.getTMRCA();
-					s.insert(n);
-				}
-				outStream << "tmrca" << "\t";
-				outStream << t + step / (double) 2 << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-			}
+		/* in explain mode the plan is printed in place of the skylines */
+		if (param.skyline_explain) {
+			plan.explain(cout, treelist);
+			return;
 		}
 		
-		// LENGTH /////////////////////
-		if (param.skyline_length) {
-			cout << "Printing length skyline to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t + step / (double) 2);
-					double n = ct.getLength();
-					s.insert(n);
-				}
-				outStream << "length" << "\t";
-				outStream << t + step / (double) 2 << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-			}
-		}		
+		plan.run(treelist, skylined);
+		skylined = treelist.size();
+				
+		/* initializing output stream */
+		string tableFile = "";
+		if (param.output_columns) { 
+			tableFile = outputFile + ".bin";
+			cout << "Printing skyline table to " << tableFile << endl; 
+		}
+		Sink outStream (outputFile, tableFile);
+		outStream << "statistic\ttime\tlower\tmean\tupper\n"; 
+		plan.print(outStream, treeChains);
+		outStream.close();
+	
+	}
 
-		// LABEL PROPORTIONS /////////////////////
-		if (param.skyline_proportions) {
-			cout << "Printing proportions skyline to " << outputFile << endl;
-			
-			for (is = lset.begin(); is != lset.end(); ++is) {
-				for (double t = start; t + step <= stop; t += step) {
-			
-					Series s;
-					for (int i = 0; i < treelist.size(); i++) {
-						CoalescentTree ct = treelist[i];
-						ct.trimEnds(t,t+step);
-					//	ct.pruneToTrunk();
-						double n = ct.getLabelPro(*is);
-						s.insert(n);
-					}
-					outStream << "pro_" << *is << "\t";
-					outStream << t + step / (double) 2 << "\t";
-					outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-					
-				}
-			}
+}
+
+/* plans every requested skyline */
+void IO::planSkylines(Planner &plan, string outputFile) {
+
+	set<string> lset = treelist[0].getLabelSet();	
+
+	double start = param.skyline_values[0];
+	double stop = param.skyline_values[1];
+	double step = param.skyline_values[2];
+	
+	/* statistics are planned as cuts of each tree and measures taken from these cuts */
+	/* statistics that need the same slice or window of a tree share a single cut */
+	int tree = plan.addCut(Planner::TREE, 0.0, 0.0, false);
+
+	// TMRCA /////////////////////
+	if (param.skyline_tmrca) {
+		cout << "Printing TMRCA skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::SLICE, t + step / (double) 2, 0.0, false);
+			int m = plan.addMeasure(c, Planner::TMRCA);
+			plan.addLine("tmrca", t + step / (double) 2, m, -1, 0.0, 0.025, 0.975);
 		}
+	}
 	
-		// COALESCENCE /////////////////////
-		if (param.skyline_coal_rates) {
-			cout << "Printing coalescent skyline to " << outputFile << endl;
-			
-			for (is = lset.begin(); is != lset.end(); ++is) {
-				for (double t = start; t + step <= stop; t += step) {
-			
-					Series s;
-					for (int i = 0; i < treelist.size(); i++) {
-						CoalescentTree ct = treelist[i];
-						ct.trimEnds(t,t+step);
-						double n = ct.getCoalRate(*is);
-						s.insert(n);
-					}
-					outStream << "coal_" << *is << "\t";
-					outStream << t + step / (double) 2 << "\t";
-					outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-					
-				}
-			}
+	// LENGTH /////////////////////
+	if (param.skyline_length) {
+		cout << "Printing length skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::SLICE, t + step / (double) 2, 0.0, false);
+			int m = plan.addMeasure(c, Planner::LENGTH);
+			plan.addLine("length", t + step / (double) 2, m, -1, 0.0, 0.025, 0.975);
 		}
-		
-		// MIGRATION ///////////////////////
-		if (param.skyline_mig_rates) {		
-			cout << "Printing migration skyline to " << outputFile << endl;
-			
+	}		
+
+	// LABEL STATISTICS /////////////////////
+	planLabelSkylines(plan, lset, "");
+	
+	// DIVERSITY /////////////////////
+	if (param.skyline_diversity) {
+		cout << "Printing diversity skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::SLICE, t + step / (double) 2, 0.0, false);
+			int m = plan.addMeasure(c, Planner::DIVERSITY);
+			plan.addLine("div", t + step / (double) 2, m, -1, 0.0, 0.025, 0.975);
+		}
+	}	
+	
+	// FST /////////////////////
+	if (param.skyline_fst) {
+		cout << "Printing FST skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::SLICE, t + step / (double) 2, 0.0, false);
+			int m = plan.addMeasure(c, Planner::FST);
+			plan.addLine("fst", t + step / (double) 2, m, -1, 0.0, 0.025, 0.975);
+		}
+	}
+	
+	// TAJIMA D /////////////////////
+	if (param.skyline_tajima_d) {
+		cout << "Printing Tajima D skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::SLICE, t + step / (double) 2, 0.0, false);
+			int m = plan.addMeasure(c, Planner::TAJIMAD);
+			plan.addLine("tajimad", t + step / (double) 2, m, -1, 0.0, 0.025, 0.975);
+		}
+	}		
+	
+	// TIME TO FIX /////////////////////
+	if (param.skyline_timetofix) {
+		cout << "Printing fixation time skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			double present = t + step / (double) 2;
+			int c = plan.addCut(Planner::TRUNKSLICE, present, 0.0, false);
+			int m = plan.addMeasure(c, Planner::PRESENT);
+			plan.addLine("timetofix", t + step / (double) 2, m, -1, present, 0.025, 0.975);
+		}
+	}		
+
+	// X LOCATION /////////////////////
+	if (param.skyline_xmean) {
+		cout << "Printing X mean skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::SLICE, t, 0.0, false);
+			int m = plan.addMeasure(c, Planner::MEANX);
+			plan.addLine("xmean", t, m, -1, 0.0, 0.25, 0.75);
+		}
+	}	
+	
+	// Y LOCATION /////////////////////
+	if (param.skyline_ymean) {
+		cout << "Printing Y mean skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::SLICE, t, 0.0, false);
+			int m = plan.addMeasure(c, Planner::MEANY);
+			plan.addLine("ymean", t, m, -1, 0.0, 0.25, 0.75);
+		}
+	}
+	
+	// TRAIT MEANS /////////////////////
+	// one line for every trait dimension, numbered from 1, with x and y as 1 and 2
+	if (param.skyline_traitmean) {
+		cout << "Printing trait mean skylines to " << outputFile << endl;
+		int dimensions = treelist[0].getDimensions();
+		for (int k = 0; k < dimensions; k++) {
+			stringstream name;
+			name << "traitmean_" << k + 1;
 			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.trimEnds(t,t+step);				
-					double n = ct.getMigRate();
-					s.insert(n);
-				}
-				outStream << "mig_all\t";
-				outStream << t + step / (double) 2 << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
+				int c = plan.addCut(Planner::SLICE, t, 0.0, false);
+				int m = plan.addMeasure(c, Planner::MEANTRAIT, "", "", k, 0.0);
+				plan.addLine(name.str(), t, m, -1, 0.0, 0.25, 0.75);
 			}
+		}
+	}
 			
-			for (is = lset.begin(); is != lset.end(); ++is) {
-				for (js = lset.begin(); js != lset.end(); ++js) {	
-					string from = *is;
-					string to = *js;
-					if (from != to) {
-						for (double t = start; t + step <= stop; t += step) {
-		
-							Series s;
-							for (int i = 0; i < treelist.size(); i++) {
-								CoalescentTree ct = treelist[i];
-								ct.trimEnds(t,t+step);
-								double n = ct.getMigRate(from,to);
-								s.insert(n);
-							}
-							outStream << "mig_" << from << "_" << to << "\t";
-							outStream << t + step / (double) 2 << "\t";
-							outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-		
-						}
-					}
-				}	
-			}
-		}		
-		
-		// PROPORTION HISTORY FROM TIPS ///////////////////////
-		if (param.skyline_pro_history_from_tips) {		
-			cout << "Printing proportion history skyline to " << outputFile << endl;
-			for (is = lset.begin(); is != lset.end(); ++is) {
-				for (js = lset.begin(); js != lset.end(); ++js) {			
-					string startingLabel = *is;
-					string endingLabel = *js;
-					for (double t = start; t + step <= stop; t += step) {
-		
-						Series s;
-						for (int i = 0; i < treelist.size(); i++) {
-							CoalescentTree ct = treelist[i];
-							double n = ct.getLabelProFromTips(endingLabel, t, startingLabel);
-							s.insert(n);
-						}
-						outStream << "prohist_" << startingLabel << "_" << endingLabel << "\t";
-						outStream << t + step / (double) 2 << "\t";
-						outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
+	// X DRIFT /////////////////////
+	if (param.skyline_xdrift) {
+		cout << "Printing X drift skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int b = plan.addMeasure( plan.addCut(Planner::SLICE, t, 0.0, false), Planner::MEANX );
+			int a = plan.addMeasure( plan.addCut(Planner::SLICE, t - step, 0.0, false), Planner::MEANX );
+			plan.addLine("xdrift", t, b, a, 0.0, 0.25, 0.75);
+		}
+	}			
 	
-					}
-				}
-			}
-		}				
-		
-		// DIVERSITY /////////////////////
-		if (param.skyline_diversity) {
-			cout << "Printing diversity skyline to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t + step / (double) 2);
-					double n = ct.getDiversity();
-					s.insert(n);
-				}
-				outStream << "div" << "\t";
-				outStream << t + step / (double) 2 << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-			}
-		}	
-		
-		// FST /////////////////////
-		if (param.skyline_fst) {
-			cout << "Printing FST skyline to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t + step / (double) 2);
-					double n = ct.getFst();
-					s.insert(n);
-				}
-				outStream << "fst" << "\t";
-				outStream << t + step / (double) 2 << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-			}
+	// RATE /////////////////////
+	if (param.skyline_ratemean) {
+		cout << "Printing rate mean skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::SLICE, t + step / (double) 2, 0.0, false);
+			int m = plan.addMeasure(c, Planner::MEANRATE);
+			plan.addLine("ratemean", t + step / (double) 2, m, -1, 0.0, 0.25, 0.75);
 		}
-		
-		// TAJIMA D /////////////////////
-		if (param.skyline_tajima_d) {
-			cout << "Printing Tajima D skyline to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t + step / (double) 2);
-					double n = ct.getTajimaD();
-					s.insert(n);
-				}
-				outStream << "tajimad" << "\t";
-				outStream << t + step / (double) 2 << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-			}
-		}		
-		
-		// TIME TO FIX /////////////////////
-		if (param.skyline_timetofix) {
-			cout << "Printing fixation time skyline to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					double present = t + step / (double) 2;
-					ct.trunkSlice(present);
-					double future = ct.getPresentTime();
-					s.insert(future-present);
-				}
-				outStream << "timetofix" << "\t";
-				outStream << t + step / (double) 2 << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-			}
-		}		
-		
+	}	
+	
+	// X LOCATION TRUNK DIFFERENCE /////////////////////
+	if (param.skyline_xtrunkdiff) {
+		cout << "Printing X trunk different to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int all = plan.addMeasure( plan.addCut(Planner::SLICE, t, 0.0, false), Planner::MEANX );
+			int trunk = plan.addMeasure( plan.addCut(Planner::SLICE, t, 0.0, true), Planner::MEANX );
+			plan.addLine("xtrunkdiff", t, trunk, all, 0.0, 0.025, 0.975);
+		}
+	}			
+	
+	// LOC SAMPLE /////////////////////
+	if (param.skyline_locsample) {
+		cout << "Printing loc sample skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::SLICE, t + step / (double) 2, 0.0, false);
+			int m = plan.addMeasure(c, Planner::TIPS);
+			plan.addLine(Planner::SAMPLE, "locsample", t + step / (double) 2, m);
+		}
+	}			
+	
+	// LOC GRID /////////////////////
+	if (param.skyline_locgrid) {
+		cout << "Printing loc grid skyline to " << outputFile << endl;
+		vector<double> &grid = param.skyline_locgrid_values;
+		plan.setGrid(grid[0], grid[1], grid[2], grid[3], grid[4], param.skyline_locgrid_sparse);
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::SLICE, t + step / (double) 2, 0.0, false);
+			int m = plan.addMeasure(c, Planner::TIPS);
+			plan.addLine(Planner::GRID, "locgrid", t, m);
+		}
+	}					
+
+	// 1D DRIFT RATE FROM TIPS /////////////////////
+	if (param.skyline_drift_rate_from_tips) {
+		cout << "Printing skyline of 1D drift rate from tips " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int m = plan.addMeasure(tree, Planner::DRIFT1D, "", "", t, step);	// need to account for undefined cases
+			plan.addLine("1dratefromtips", t + step / (double) 2, m, -1, 0.0, 0.25, 0.75);
+		}
+	}		
+	
+	// 2D DRIFT RATE FROM TIPS /////////////////////
+	if (param.skyline_drift_rate_from_tips) {
+		cout << "Printing skyline of 2D drift rate from tips " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int m = plan.addMeasure(tree, Planner::DRIFT2D, "", "", t, step);	// need to account for undefined cases
+			plan.addLine("2dratefromtips", t + step / (double) 2, m, -1, 0.0, 0.25, 0.75);
+		}
+	}			
+	
+	// FURTHER DISCRETE TRAITS /////////////////////
+	// cuts of each trait are taken together, after labels are exchanged with the trait
+	vector< set<string> > dsets = getDiscreteSets();
+	for (int d = 1; d < dsets.size(); d++) {
+		plan.setDiscrete(d);
+		planLabelSkylines(plan, dsets[d], discreteKeys[d-1]);
+	}
+	plan.setDiscrete(0);
 
-		// X LOCATION /////////////////////
-		if (param.skyline_xmean) {
-			cout << "Printing X mean skyline to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t);
-					double n = ct.getMeanX();
-					s.insert(n);
-				}
-				outStream << "xmean" << "\t";
-				outStream << t << "\t";
-				outStream << s.quantile(0.25) << "\t" << s.mean() << "\t" << s.quantile(0.75) << endl;
-			}
-		}	
-		
-		// Y LOCATION /////////////////////
-		if (param.skyline_ymean) {
-			cout << "Printing Y mean skyline to " << outputFile << endl;
+}
+
+/* plans label skylines for the discrete trait selected in plan, the label as read has no key */
+void IO::planLabelSkylines(Planner &plan, set<string> &lset, string key) {
+
+	string outputFile = outputPrefix + ".skylines";
+	string prefix = "";
+	string trait = "";
+	if (key != "") {
+		prefix = key + "_";
+		trait = key + " ";
+	}
+
+	set<string>::const_iterator is;
+	set<string>::const_iterator js;
+
+	double start = param.skyline_values[0];
+	double stop = param.skyline_values[1];
+	double step = param.skyline_values[2];
+	
+	int tree = plan.addCut(Planner::TREE, 0.0, 0.0, false);
+
+	// LABEL PROPORTIONS /////////////////////
+	if (param.skyline_proportions) {
+		cout << "Printing " << trait << "proportions skyline to " << outputFile << endl;
+		for (is = lset.begin(); is != lset.end(); ++is) {
 			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t);
-					double n = ct.getMeanY();
-					s.insert(n);
-				}
-				outStream << "ymean" << "\t";
-				outStream << t << "\t";
-				outStream << s.quantile(0.25) << "\t" << s.mean() << "\t" << s.quantile(0.75) << endl;
+				int c = plan.addCut(Planner::TRIM, t, t + step, false);
+				int m = plan.addMeasure(c, Planner::LABELPRO, *is, "", 0.0, 0.0);
+				plan.addLine(prefix + "pro_" + *is, t + step / (double) 2, m, -1, 0.0, 0.025, 0.975);
 			}
 		}
-				
-		// X DRIFT /////////////////////
-		if (param.skyline_xdrift) {
-			cout << "Printing X drift skyline to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree bt = treelist[i];
-					bt.timeSlice(t);
-					double b = bt.getMeanX();
-					CoalescentTree at = treelist[i];
-					at.timeSlice(t-step);
-					double a = at.getMeanX();
-					s.insert(b-a);
-				}
-				outStream << "xdrift" << "\t";
-				outStream << t << "\t";
-				outStream << s.quantile(0.25) << "\t" << s.mean() << "\t" << s.quantile(0.75) << endl;
-			}
-		}			
-		
-		// RATE /////////////////////
-		if (param.skyline_ratemean) {
-			cout << "Printing rate mean skyline to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t + step / (double) 2);
-					double n = ct.getMeanRate();
-					s.insert(n);
-				}
-				outStream << "ratemean" << "\t";
-				outStream << t + step / (double) 2 << "\t";
-				outStream << s.quantile(0.25) << "\t" << s.mean() << "\t" << s.quantile(0.75) << endl;
-			}
-		}	
-		
-		// X LOCATION TRUNK DIFFERENCE /////////////////////
-		if (param.skyline_xtrunkdiff) {
-			cout << "Printing X trunk different to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t);
-					double all = ct.getMeanX();
-					ct = treelist[i];
-					ct.pruneToTrunk();
-					ct.timeSlice(t);
-					double trunk = ct.getMeanX();
-					s.insert(trunk-all);
-				}
-				outStream << "xtrunkdiff" << "\t";
-				outStream << t << "\t";
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
-			}
-		}			
-		
-		// LOC SAMPLE /////////////////////
-		if (param.skyline_locsample) {
-			cout << "Printing loc sample skyline to " << outputFile << endl;
+	}
+
+	// COALESCENCE /////////////////////
+	if (param.skyline_coal_rates) {
+		cout << "Printing " << trait << "coalescent skyline to " << outputFile << endl;
+		for (is = lset.begin(); is != lset.end(); ++is) {
 			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				outStream << "locsample" << "\t" << t + step / (double) 2;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t + step / (double) 2);
-					vector<double> xlocs = ct.getTipsX();
-					vector<double> ylocs = ct.getTipsY();
-					int length = xlocs.size();
-					if (length > 50000) { length = 50000; }
-					for (int i = 0; i < length; i++) {
-						double x = xlocs[i];
-						double y = ylocs[i];
-						if (x < 0.001 && x > -0.001) { x = 0.0; }
-						if (y < 0.001 && y > -0.001) { y = 0.0; }
-						outStream << "\t{" << x << "," << y << "}";
-					}
-				}
-				outStream << endl;
+				int c = plan.addCut(Planner::TRIM, t, t + step, false);
+				int m = plan.addMeasure(c, Planner::COALRATE, *is, "", 0.0, 0.0);
+				plan.addLine(prefix + "coal_" + *is, t + step / (double) 2, m, -1, 0.0, 0.025, 0.975);
 			}
-		}			
-		
-		// LOC GRID /////////////////////
-		if (param.skyline_locgrid) {
-			cout << "Printing loc grid skyline to " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				
-				outStream << "locgrid" << "\t" << t;
-				
-				multiset< vector<double> > locset;
-				
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					ct.timeSlice(t + step / (double) 2);
-					vector<double> xlocs = ct.getTipsX();
-					vector<double> ylocs = ct.getTipsY();
-					for (int i = 0; i < xlocs.size(); i++) {
-						vector<double> v;
-						v.push_back(xlocs[i]);
-						v.push_back(ylocs[i]);
-						locset.insert(v);
-					}
-				
-				}
-				
-				double step = 0.25;
-				for (double x = -2.0; x <= 50.0; x += step) {
-					for (double y = -6.0; y <= 6.0; y += step) {
-					
-						int count = 0;
-						for (multiset< vector<double> >::iterator is = locset.begin(); is != locset.end(); is++ ) {
-							double thisx = (*is).at(0);
-							double thisy = (*is).at(1);
-							if (thisx < x + 0.5*step && thisx > x - 0.5*step && thisy < y + 0.5*step && thisy > y - 0.5*step) {
-								count++;
-							}
-						}
-						outStream << "\t" << count;
-				
+		}
+	}
+	
+	// MIGRATION ///////////////////////
+	if (param.skyline_mig_rates) {		
+		cout << "Printing " << trait << "migration skyline to " << outputFile << endl;
+		for (double t = start; t + step <= stop; t += step) {
+			int c = plan.addCut(Planner::TRIM, t, t + step, false);
+			int m = plan.addMeasure(c, Planner::MIGRATE);
+			plan.addLine(prefix + "mig_all", t + step / (double) 2, m, -1, 0.0, 0.025, 0.975);
+		}
+		for (is = lset.begin(); is != lset.end(); ++is) {
+			for (js = lset.begin(); js != lset.end(); ++js) {	
+				string from = *is;
+				string to = *js;
+				if (from != to) {
+					for (double t = start; t + step <= stop; t += step) {
+						int c = plan.addCut(Planner::TRIM, t, t + step, false);
+						int m = plan.addMeasure(c, Planner::MIGRATE, from, to, 0.0, 0.0);
+						plan.addLine(prefix + "mig_" + from + "_" + to, t + step / (double) 2, m, -1, 0.0, 0.025, 0.975);
 					}
 				}
-				
-				outStream << endl;
-			}
-		}					
-
-		// 1D DRIFT RATE FROM TIPS /////////////////////
-		if (param.skyline_drift_rate_from_tips) {
-			cout << "Printing skyline of 1D drift rate from tips " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					double n = ct.get1DRateFromTips(t, step);	// need to account for undefined cases
-					s.insert(n);
-				}
-				outStream << "1dratefromtips" << "\t";
-				outStream << t + step / (double) 2 << "\t";
-				outStream << s.quantile(0.25) << "\t" << s.mean() << "\t" << s.quantile(0.75) << endl;
-			}
-		}		
-		
-		// 2D DRIFT RATE FROM TIPS /////////////////////
-		if (param.skyline_drift_rate_from_tips) {
-			cout << "Printing skyline of 2D drift rate from tips " << outputFile << endl;
-			for (double t = start; t + step <= stop; t += step) {
-				Series s;
-				for (int i = 0; i < treelist.size(); i++) {
-					CoalescentTree ct = treelist[i];
-					double n = ct.get2DRateFromTips(t, step);	// need to account for undefined cases
-					s.insert(n);
+			}	
+		}
+	}		
+	
+	// PROPORTION HISTORY FROM TIPS ///////////////////////
+	if (param.skyline_pro_history_from_tips) {		
+		cout << "Printing " << trait << "proportion history skyline to " << outputFile << endl;
+		for (is = lset.begin(); is != lset.end(); ++is) {
+			for (js = lset.begin(); js != lset.end(); ++js) {			
+				string startingLabel = *is;
+				string endingLabel = *js;
+				for (double t = start; t + step <= stop; t += step) {
+					int m = plan.addMeasure(tree, Planner::PROHIST, startingLabel, endingLabel, t, 0.0);
+					plan.addLine(prefix + "prohist_" + startingLabel + "_" + endingLabel, t + step / (double) 2, m, -1, 0.0, 0.025, 0.975);
 				}
-				outStream << "2dratefromtips" << "\t";
-				outStream << t + step / (double) 2 << "\t";
-				outStream << s.quantile(0.25) << "\t" << s.mean() << "\t" << s.quantile(0.75) << endl;
 			}
-		}			
-				
-		outStream.close();
-	
+		}
 	}
 
 }
@@ -1180,12 +1073,13 @@ void IO::printTips() {
 
 	if (param.tips()) {
 
+		loadTrees();
+
 		/* initializing output stream */
 		string outputFile = outputPrefix + ".tips";
-		ofstream outStream;
-		outStream.open( outputFile.c_str(),ios::app);
+		Sink outStream (outputFile);
 		
-		outStream << "statistic\tname\tlabel\ttime\tlower\tmean\tupper" << endl; 
+		outStream << "statistic\tname\tlabel\ttime\tlower\tmean\tupper\n"; 
 		
 		/* get vector of tip names */
 		vector<string> tipNames = treelist[0].getTipNames();
@@ -1204,116 +1098,108 @@ void IO::printTips() {
 				outStream << tip << "\t";
 				outStream << treelist[0].getLabel(tip) << "\t";
 				outStream << treelist[0].getTime(tip) << "\t";				
-				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;		
+				outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << '\n';		
 			}
 		}
 		
 		// X LOC HISTORY //////////////
 		if (param.x_loc_history) {
-		
 			cout << "Printing x loc history for tips to " << outputFile << endl;
-			double start = param.x_loc_history_values[0];
-			double stop = param.x_loc_history_values[1];
-			double step = param.x_loc_history_values[2];
-			
-			for (int n = 0; n < tipNames.size(); n++) {
-			
-				string tip = tipNames[n];
-				outStream << "x_loc_history" << "\t";
-				outStream << tip << "\t";
-								
-				vector<CoalescentTree> subtreelist;
-				for (vector<CoalescentTree>::iterator it = treelist.begin(); it != treelist.end(); it++ ) {
-					CoalescentTree ct = *it;
-					ct.pruneToName(tip);
-		//			ct.assignLocation();
-					subtreelist.push_back(ct);
-				}		
-									
-				double endTime = subtreelist[0].getPresentTime();
-									
-				for (double t = start; t <= endTime; t += step) {
-				
-					Series sx;
-					for (vector<CoalescentTree>::iterator it = subtreelist.begin(); it != subtreelist.end(); it++ ) {
-						CoalescentTree ct = *it;
-						ct.timeSlice(t);
-						double x = ct.getMeanX();
-						sx.insert(x);
-					}		
-					double xmean = sx.quantile(0.5);
-					double xlower = sx.quantile(0.25);
-					double xupper = sx.quantile(0.75);	
-			//		double xmean = sx.mean();
-			//		double xlower = sx.sdrange(-1);
-			//		double xupper = sx.sdrange(1);				
-					if (t < 0.0001 && t > -0.0001) { t = 0.0; }					
-					if (xmean < 0.0001 && xmean > -0.0001) { xmean = 0.0; }
-					if (xlower < 0.0001 && xlower > -0.0001) { xlower = 0.0; }
-					if (xupper < 0.0001 && xupper > -0.0001) { xupper = 0.0; }					
-					outStream << "\t{" << t << "," << xlower << "," << xmean << "," << xupper << "}";
-					
-				}
-				
-				outStream << endl;
-				
-			}
+			printLocHistory(outStream, "x_loc_history", param.x_loc_history_values, false, 0.25, 0.75);
 		}
 		
 		// Y LOC HISTORY //////////////
 		if (param.y_loc_history) {
-		
 			cout << "Printing y loc history for tips to " << outputFile << endl;
-			double start = param.y_loc_history_values[0];
-			double stop = param.y_loc_history_values[1];
-			double step = param.y_loc_history_values[2];
+			printLocHistory(outStream, "y_loc_history", param.y_loc_history_values, true, 0.025, 0.975);
+		}		
+		
+		outStream.close();
+	
+	}
+
+}
+
+/* location along the path to each tip, at times stepped from start to the date of the tip */
+/* tips are taken in blocks, and each tree is flattened once per block to trace every path in the block */
+void IO::printLocHistory(Sink &outStream, string statistic, vector<double> values, bool useY, double lowerQuantile, double upperQuantile) {
+
+	double start = values[0];
+	double step = values[2];
+	const int blockSize = 256;
+
+	vector<string> tipNames = treelist[0].getTipNames();
+	TreeView view;
+	
+	for (int first = 0; first < tipNames.size(); first += blockSize) {
+	
+		int last = first + blockSize;
+		if (last > tipNames.size()) { last = tipNames.size(); }
+		vector<string> names (tipNames.begin() + first, tipNames.begin() + last);
+		int B = names.size();
+		
+		/* each tip is followed up to its date in the first tree */
+		view.attach(treelist[0]);
+		view.tracePaths(names);
+		vector<double> endTimes (B);
+		double maxTime = 0.0 / 0.0;
+		for (int k = 0; k < B; k++) {
+			endTimes[k] = view.getPathPresentTime(k);
+			if (endTimes[k] > maxTime || maxTime != maxTime) { maxTime = endTimes[k]; }
+		}
+		
+		/* times are stepped as they are printed, snapping to zero, and each tip takes those up to its date */
+		vector<double> times;
+		for (double t = start; t <= maxTime; t += step) {
+			times.push_back(t);
+			if (t < 0.0001 && t > -0.0001) { t = 0.0; }
+		}
+		vector<int> counts (B, 0);
+		for (int k = 0; k < B; k++) {
+			while (counts[k] < times.size() && times[counts[k]] <= endTimes[k]) { counts[k]++; }
+		}
+		
+		vector< vector<Series> > series (B);
+		for (int k = 0; k < B; k++) {
+			series[k].resize(counts[k]);
+		}
+		vector<double> xs, ys;
+		for (int i = 0; i < treelist.size(); i++) {
+			view.attach(treelist[i]);
+			view.tracePaths(names);
+			for (int k = 0; k < B; k++) {
+				vector<double> tipTimes (times.begin(), times.begin() + counts[k]);
+				view.slicePath(k, tipTimes, xs, ys);
+				vector<double> &locs = useY ? ys : xs;
+				for (int j = 0; j < counts[k]; j++) {
+					series[k][j].insert(locs[j]);
+				}
+			}
+		}
+		
+		for (int k = 0; k < B; k++) {
 			
-			for (int n = 0; n < tipNames.size(); n++) {
+			outStream << statistic << "\t";
+			outStream << names[k] << "\t";
 			
-				string tip = tipNames[n];
-				outStream << "y_loc_history" << "\t";
-				outStream << tip << "\t";
-								
-				vector<CoalescentTree> subtreelist;
-				for (vector<CoalescentTree>::iterator it = treelist.begin(); it != treelist.end(); it++ ) {
-					CoalescentTree ct = *it;
-					ct.pruneToName(tip);
-				//	ct.assignLocation();
-					subtreelist.push_back(ct);
-				}		
-									
-				double endTime = subtreelist[0].getPresentTime();
-									
-				for (double t = start; t <= endTime; t += step) {
-				
-					Series sy;
-					for (vector<CoalescentTree>::iterator it = subtreelist.begin(); it != subtreelist.end(); it++ ) {
-						CoalescentTree ct = *it;
-						ct.timeSlice(t);
-						double y = ct.getMeanY();
-						sy.insert(y);
-					}		
-					double ymean = sy.quantile(0.5);
-					double ylower = sy.quantile(0.025);
-					double yupper = sy.quantile(0.975);	
-			//		double ymean = sy.mean();
-			//		double ylower = sy.sdrange(-1);
-			//		double yupper = sy.sdrange(1);				
-					if (t < 0.0001 && t > -0.0001) { t = 0.0; }					
-					if (ymean < 0.0001 && ymean > -0.0001) { ymean = 0.0; }
-					if (ylower < 0.0001 && ylower > -0.0001) { ylower = 0.0; }
-					if (yupper < 0.0001 && yupper > -0.0001) { yupper = 0.0; }					
-					outStream << "\t{" << t << "," << ylower << "," << ymean << "," << yupper << "}";
-					
-				}
-				
-				outStream << endl;
+			for (int j = 0; j < counts[k]; j++) {
+			
+				double t = times[j];
+				double mean = series[k][j].quantile(0.5);
+				double lower = series[k][j].quantile(lowerQuantile);
+				double upper = series[k][j].quantile(upperQuantile);	
+				if (t < 0.0001 && t > -0.0001) { t = 0.0; }					
+				if (mean < 0.0001 && mean > -0.0001) { mean = 0.0; }
+				if (lower < 0.0001 && lower > -0.0001) { lower = 0.0; }
+				if (upper < 0.0001 && upper > -0.0001) { upper = 0.0; }					
+				outStream << "\t{" << t << "," << lower << "," << mean << "," << upper << "}";
 				
 			}
-		}		
+			
+			outStream << '\n';
+		
+		}
 		
-		outStream.close();
-	
 	}
 
 }
@@ -1322,17 +1208,20 @@ void IO::printTips() {
 void IO::printPairs() {
 	
 	if (param.pairs()) {
+
+		loadTrees();
 		
 		/* initializing output stream */
 		string outputFile = outputPrefix + ".pairs";
-		ofstream outStream;
-		outStream.open( outputFile.c_str(),ios::app);
+		Sink outStream (outputFile);
 		
-		outStream << "statistic\tnameA\tnameB\tlower\tmean\tupper" << endl; 
+		outStream << "statistic\tnameA\tnameB\tlower\tmean\tupper\n"; 
 		
 		/* get vector of tip names */
 		vector<string> tipNames = treelist[0].getTipNames();
 		
+		TreeView view;
+		
 		// PAIRWISE DIVERSITY //////////////
 		if (param.pairs_diversity) {
 		
@@ -1359,7 +1248,7 @@ void IO::printPairs() {
 						outStream << "diversity" << "\t";
 						outStream << tipA << "\t";
 						outStream << tipB << "\t";								
-						outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << endl;
+						outStream << s.quantile(0.025) << "\t" << s.mean() << "\t" << s.quantile(0.975) << '\n';
 					
 					}
 				
@@ -1372,11 +1261,353 @@ void IO::printPairs() {
 	
 }
 
+/* indexes trees appended to every chain since it was last indexed, returns count of trees added */
+/* log probabilities are kept for held trees alone once any tree is passed over after burnin */
+int IO::indexChains() {
+
+	int before = treeOffsets.size();
+	bool realigned = param.thin || param.subsample || inputFiles.size() > 1;
+	for (int c = 0; c < inputFiles.size(); c++) {
+		int burnin = -1;
+		int thinning = 1;
+		if (param.burnin) { burnin = (int) (param.burnin_values)[0]; }
+		if (param.thin) { thinning = (int) (param.thin_values)[0]; }
+		if (param.chain && (param.chain_burnins)[c] >= 0) { burnin = (int) (param.chain_burnins)[c]; }
+		if (param.chain && (param.chain_thins)[c] >= 0) { thinning = (int) (param.chain_thins)[c]; }
+		probsComplete = indexChain(c, burnin, thinning, realigned) && probsComplete;
+	}
+	if (realigned && !probsComplete) {
+		problist.clear();
+	}
+	treeSlots.resize(treeOffsets.size(), -1);
+	if (treeOffsets.size() > before) {
+		loaded = false;
+	}
+	
+	return treeOffsets.size() - before;
+
+}
+
+/* indexes the trees of one chain, appending offsets and, if realigned, the log probability of each held */
+/* tree; after burnin, every thinning-th tree is a candidate, and a reservoir of subsample candidates is */
+/* kept, each candidate replacing a held tree with the chance that leaves every candidate equally likely */
+/* to be held; only offsets are held, so that skipped trees are never read into memory */
+/* indexing resumes after the last tree found before, and a last line without an end is left for later */
+/* returns whether every held tree has a log probability */
+bool IO::indexChain(int chain, int burnin, int thinning, bool realigned) {
+
+	string inputFile = inputFiles[chain];
+	bool first = chainEnds[chain] == 0;
+	if (first) {
+		cout << "Indexing trees in " << inputFile << endl;
+	}
+
+	ifstream inStream;
+	inStream.open( inputFile.c_str(),ios::in | ios::binary);
+	inStream.seekg(chainEnds[chain]);
+
+	int reservoir = -1;
+	unsigned long seed = 0;
+	if (param.subsample) {
+		reservoir = (int) (param.subsample_values)[0];
+		seed = (unsigned long) (param.subsample_values)[1] + chain;
+	}
+	RNG rgen(seed);
+	vector<streamoff> offsets;
+	vector<streamoff> lengths;
+	vector<int> order;							// position among candidates of each held tree
+	vector<int> probs;							// index into chain log probabilities of each held tree, -1 if none
+	vector<double> chainProbs;
+	int candidates = chainCandidates[chain];
+	int lastProb = -1;
+	int probsRead = 0;							// log probabilities up to the last tree
+
+	// a line is held up to its first '(', which starts a tree, and the rest of a tree line is passed
+	// over a buffer at a time; ln(L) lines are held whole
+	Scanner scanner (inStream, -1);
+	string line;
+	int pos;
+	int treesread = chainTrees[chain];
+	streamoff base = chainEnds[chain];
+	streamoff lineStart = base;
+	if (inStream.is_open()) {
+		while (scanner.more()) {
+			streamoff offset = lineStart;
+			line = "";
+			bool ended = false;
+			streamoff treeLength = 0;
+			while (scanner.more()) {
+				char c = scanner.get();
+				if (c == '\n') {
+					ended = true;
+					break;
+				}
+				line += c;
+				if (c == '(' && line[0] != '#' && (line.size() < 3 || line.compare(line.size() - 3, 3, "ln(") != 0)) {
+					ended = scanner.skipLine(treeLength);
+					treeLength++;
+					break;
+				}
+			}
+			lineStart = base + scanner.position();
+			
+			if (line.compare(0, 4, "End;") == 0 || line.compare(0, 4, "END;") == 0) {
+				chainEnded[chain] = true;
+			}
+			
+			// the tree file may still be growing while following
+			if (param.follow && !ended) {
+				break;
+			}
+			
+			if (line.size() > 0) {
+				if (line[0] != '#') {
+			
+					// Catching log probabilities of trees
+					string annoString;
+					
+					// migrate annotation
+					annoString = "ln(L) = ";
+					pos = line.find(annoString);
+		
+					if (pos >= 0) {
+						string thisString;
+						thisString = line.substr(pos+annoString.size());
+						thisString.erase(thisString.find(' '));
+						double ll = atof(thisString.c_str());
+						chainProbs.push_back(ll);
+						lastProb = chainProbs.size() - 1;
+						line = "";								// ignore rest of line
+					}
+					
+					// beast annotation
+					annoString = "[&lnP=";
+					pos = line.find(annoString);
+		
+					if (pos >= 0) {
+						string thisString;
+						thisString = line.substr(pos+annoString.size());
+						thisString.erase(thisString.find(']'));
+						double ll = atof(thisString.c_str());
+						chainProbs.push_back(ll);				
+						lastProb = chainProbs.size() - 1;
+					}
+					
+					// find first occurance of '(' in line
+					pos = line.find('(');
+					if (pos >= 0) {
+					
+						// if burnin has finished
+						if (burnin < 0 || treesread > burnin) {
+							if (candidates % thinning == 0) {
+								int held = candidates / thinning;
+								int slot = offsets.size();
+								if (reservoir < 0 || held < reservoir) {
+									offsets.push_back(0);
+									lengths.push_back(0);
+									order.push_back(0);
+									probs.push_back(0);
+								}
+								else {
+									slot = (int) rgen.uniform(0, held + 1);
+								}
+								if (slot < offsets.size()) {
+									offsets[slot] = offset + pos;
+									lengths[slot] = treeLength;
+									order[slot] = held;
+									probs[slot] = lastProb;
+								}
+							}
+							candidates++;
+						}
+						
+						treesread++;
+						lastProb = -1;
+						chainEnds[chain] = lineStart;
+						probsRead = chainProbs.size();
+							
+					}
+
+				}
+			}			
+		}
+		inStream.close();
+	}
+	else {
+		throw runtime_error("tree file " + inputFile + " not found");
+	}
+	
+	// held trees are put back in the order they appear
+	vector< pair<int,int> > sorted;
+	for (int i = 0; i < order.size(); i++) {
+		sorted.push_back(pair<int,int>(order[i], i));
+	}
+	sort(sorted.begin(), sorted.end());
+	bool complete = true;
+	for (int i = 0; i < sorted.size(); i++) {
+		int j = sorted[i].second;
+		treeOffsets.push_back(offsets[j]);
+		treeLengths.push_back(lengths[j]);
+		treeChains.push_back(chain);
+		if (probs[j] < 0) {
+			complete = false;
+		}
+		else if (realigned) {
+			problist.push_back(chainProbs[probs[j]]);
+		}
+	}
+	if (!realigned) {
+		problist.insert(problist.end(), chainProbs.begin(), chainProbs.begin() + probsRead);
+	}
+	
+	chainTrees[chain] = treesread;
+	chainCandidates[chain] = candidates;
+	
+	if (first) {
+		if (param.thin || param.subsample) {
+			cout << candidates << " trees after burnin, ";
+		}
+		cout << offsets.size() << " trees indexed" << endl;
+		if (inputFiles.size() > 1 && offsets.size() == 0 && !param.follow) {
+			throw runtime_error("no suitable trees in " + inputFile);
+		}
+	}
+	
+	return complete;
+
+}
+
+/* parses tree from its place in its tree file onto the end of trees, reading a buffer at a time rather */
+/* than the whole line, and building the tree in place rather than copying it */
+void IO::readTree(ifstream &inStream, int i, vector<CoalescentTree> &trees) {
+
+	// a huge tree is parsed as subtrees on separate threads, unless threads are already busy with chains
+	#ifdef _OPENMP
+	if (treeLengths[i] >= (1 << 22) && omp_get_max_threads() > 1 && !omp_in_parallel()) {
+		Splitter split (inputFiles[treeChains[i]], treeOffsets[i], treeLengths[i], 4 * omp_get_max_threads());
+		if (split.size() > 1) {
+			trees.emplace_back(split, roles, discreteKeys);
+			return;
+		}
+	}
+	#endif
+
+	inStream.seekg(treeOffsets[i]);
+	Scanner scanner (inStream, treeLengths[i]);
+	trees.emplace_back(scanner, roles, discreteKeys);
+
+}
+
+/* parses tree on first use, the reference lasts until another tree is parsed */
+CoalescentTree & IO::getTree(int i) {
+
+	if (treeSlots[i] < 0) {
+		ifstream inStream;
+		inStream.open( inputFiles[treeChains[i]].c_str(),ios::in | ios::binary);
+		readTree(inStream, i, treelist);
+		treeSlots[i] = treelist.size() - 1;
+	}
+	return treelist[treeSlots[i]];
+
+}
+
+/* parses every tree not yet used, after which treelist holds every tree in order */
+/* chains are parsed in parallel, each from its own stream, and errors are raised once all have finished */
+/* trees already held in order are kept, so that only trees appended while following are parsed */
+void IO::loadTrees() {
+
+	if (loaded) {
+		return;
+	}
+
+	for (int c = 0; c < inputFiles.size(); c++) {
+		cout << "Reading trees from " << inputFiles[c] << endl;
+	}
+	
+	// trees already at their own place in treelist are kept, and a single chain is parsed onto them
+	int first = 0;
+	while (first < treelist.size() && treeSlots[first] == first) {
+		first++;
+	}
+	if (first < treelist.size()) {
+		first = 0;
+	}
+	
+	// trees are not copied as the vectors grow
+	vector< vector<CoalescentTree> > parsed (inputFiles.size());
+	if (inputFiles.size() == 1 && first > 0) {
+		parsed[0].swap(treelist);
+	}
+	vector<int> counts (inputFiles.size(), 0);
+	for (int i = first; i < treeOffsets.size(); i++) {
+		counts[treeChains[i]]++;
+	}
+	for (int c = 0; c < inputFiles.size(); c++) {
+		parsed[c].reserve(parsed[c].size() + counts[c]);
+	}
+	
+	vector<string> errors (inputFiles.size());
+	#pragma omp parallel for schedule(dynamic) if (inputFiles.size() > 1)
+	for (int c = 0; c < inputFiles.size(); c++) {
+		try {
+			ifstream inStream;
+			inStream.open( inputFiles[c].c_str(),ios::in | ios::binary);
+			for (int i = first; i < treeOffsets.size(); i++) {
+				if (treeChains[i] != c) {
+					continue;
+				}
+				if (treeSlots[i] < 0) {
+					readTree(inStream, i, parsed[c]);
+					#pragma omp critical
+					cout << unitbuf << ".";
+				}
+				else {
+					parsed[c].push_back(treelist[treeSlots[i]]);
+				}
+			}
+		}
+		catch (runtime_error &e) {
+			errors[c] = e.what();
+		}
+	}
+	for (int c = 0; c < inputFiles.size(); c++) {
+		if (errors[c].size() > 0) {
+			throw runtime_error(errors[c]);
+		}
+	}
+	
+	// a single chain is taken whole, otherwise trees are drawn from their chains in index order
+	vector<CoalescentTree> all;
+	if (inputFiles.size() == 1) {
+		all.swap(parsed[0]);
+	}
+	else {
+		if (first > 0) {
+			all.swap(treelist);
+		}
+		all.reserve(treeOffsets.size());
+		vector<int> next (inputFiles.size(), 0);
+		for (int i = first; i < treeOffsets.size(); i++) {
+			int c = treeChains[i];
+			all.push_back(parsed[c][next[c]]);
+			next[c]++;
+		}
+	}
+	for (int i = first; i < treeOffsets.size(); i++) {
+		treeSlots[i] = i;
+	}
+	treelist.swap(all);
+	loaded = true;
+	
+	cout << endl;
+
+}
+
 /* go through problist and treelist and return index of highest posterior probability tree */
 int IO::getBestTree() {
 
 	int index;
-	if (problist.size() == treelist.size()) {
+	if (problist.size() == treeOffsets.size()) {
 		
 		double ll = problist[0];
 		index = 0;
@@ -1389,7 +1620,7 @@ int IO::getBestTree() {
 		
 	}
 	else {
-		index = treelist.size() - 1;
+		index = treeOffsets.size() - 1;
 	}
 	
 	return index;
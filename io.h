@@ -29,14 +29,28 @@ You should have received a copy of the GNU General Public License along with PAC
 #ifndef IO_H
 #define IO_H
 
+#include <fstream>
+using std::ifstream;
+using std::streamoff;
+
+#include <map>
+using std::map;
+
 #include <string>
 using std::string;
 
+#include <set>
+using std::set;
+
 #include <vector>
 using std::vector;
 
 #include "coaltree.h"
+#include "treeview.h"
+#include "summary.h"
+#include "planner.h"
 #include "param.h"
+#include "sink.h"
 
 class IO {
 
@@ -49,14 +63,47 @@ public:
 	void printTips();						// print tip statistics to .tips
 	void printSkylines();					// print skyline values to .skylines
 	void printPairs();						// pair pair statistics to .pairs
+	void follow();							// adds trees appended to tree files to summaries and skylines
 																			
 private:
 	Parameters param;						// parameters object, read from in.param
-	string inputFile;						// complete name of input tree file
+	vector<string> inputFiles;				// tree file of each chain, in.trees alone by default
 	string outputPrefix;					// prefix for output files .rules and .stats
-	vector<CoalescentTree> treelist;		// vector of coalescent trees
+	vector<CoalescentTree> treelist;		// vector of coalescent trees, in order once loaded
+	vector<streamoff> treeOffsets;			// byte offset of each tree in input file, after burnin
+	vector<streamoff> treeLengths;
+	vector<int> treeChains;					// chain of each tree, chains hold consecutive trees until
+											// trees are appended while following
+	vector<streamoff> chainEnds;			// bytes of each tree file indexed, up to the end of its last tree
+	vector<int> chainTrees;					// trees read from each tree file, including burnin
+	vector<int> chainCandidates;			// trees read from each tree file after burnin
+	vector<bool> chainEnded;				// tree file has its closing End; line
+	bool probsComplete;						// every held tree has a log probability
+	vector<int> treeSlots;					// position of each tree in treelist, -1 until parsed
+	bool loaded;							// every tree parsed and in order
+	int manipulated;						// trees already manipulated, summarized and evaluated
+	int summarized;
+	int skylined;
+	Summary summary;						// summary statistics of every tree summarized
+	Planner skylinePlan;					// skyline measures of every tree evaluated
+	map<string,int> roles;					// roles of annotation keys, passed to every tree
 	vector<double> problist;				// vector of assocatied probabilities
+	vector<string> discreteKeys;			// annotation keys of discrete traits beyond the label
 	int getBestTree();						// return index of highest probability tree
+	int indexChains();						// indexes trees appended to every chain, returns count added
+	bool indexChain(int,int,int,bool);		// indexes trees of chain after burnin and thinning
+	void readTree(ifstream &,int,vector<CoalescentTree> &);	// parses tree at its offset onto the end
+											// of trees
+	CoalescentTree & getTree(int);			// parses a single tree on first use
+	void loadTrees();						// parses every tree, called by anything that visits them all
+	void printLocHistory(Sink &,string,vector<double>,bool,double,double);	// prints quantiles of x or y
+											// location along the path to every tip
+	vector< set<string> > getDiscreteSets();	// label set of every discrete trait in the first tree
+	void addLabelSummaries(Summary &,TreeView &,CoalescentTree &,set<string> &,string);	// label
+											// statistics of the selected discrete trait, named after its key
+	void planSkylines(Planner &,string);	// plans every requested skyline, printed to this file
+	void planLabelSkylines(Planner &,set<string> &,string);	// label skylines of the discrete trait
+											// selected in plan, named after its key
 
 };
 
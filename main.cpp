@@ -30,12 +30,42 @@ You should have received a copy of the GNU General Public License along with PAC
 // Class for coalescent nodes within a tree object
 #include "node.h"
 
+// Typed column of tree annotations, and the roles annotations are mapped to
+#include "annotation.h"
+
+// Hands out characters of a string or of a stretch of a file, reading files a buffer at a time
+#include "scanner.h"
+
+// Finds subtrees of a single huge tree that can be parsed on separate threads
+#include "splitter.h"
+
 // Extension of the tree class to deal specifically with coalescent trees
 #include "coaltree.h"
 
+// Presents a coalescent tree as sliced or trimmed in time without copying it
+#include "treeview.h"
+
+// Selects tips within a coalescent tree, used to combine prunes
+#include "mask.h"
+
 // Collects a series of measurements, usually from multiple trees
 #include "series.h"
 
+// Writes rows of output as buffered text, and optionally as a columnar binary table
+#include "sink.h"
+
+// Collects summary statistics across trees, one row per statistic
+#include "summary.h"
+
+// Plans skyline statistics so that slices and windows of trees are shared
+#include "planner.h"
+
+// Writes rule lists for every tree, to separate files or to an indexed archive
+#include "rulewriter.h"
+
+// Writes every tree in annotated NEWICK or NEXUS format
+#include "newickwriter.h"
+
 // Input Migrate and Beast tree files and output Mathematica trees and tables of statistics
 #include "io.h"
 
@@ -64,6 +94,7 @@ int main() {
 		trees.printTips();
 		trees.printSkylines();
 		trees.printPairs();
+		trees.follow();
 	}
 	catch (runtime_error rex) {
 		cout << "<<< runtime_error >>>" << endl;
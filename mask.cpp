@@ -0,0 +1,105 @@
+/* mask.cpp
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Member function definitions for Mask class
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <stdexcept>
+using std::runtime_error;
+using std::out_of_range;
+
+#include <vector>
+using std::vector;
+
+#include "mask.h"
+
+Mask::Mask() {
+	n = 0;
+}
+
+Mask::Mask(int size, bool value) {
+	n = size;
+	bits.assign((n + 31) / 32, value ? ~0u : 0u);
+	if (value && n % 32 != 0) {
+		bits.back() = (1u << (n % 32)) - 1u;
+	}
+}
+
+int Mask::size() {
+	return n;
+}
+
+/* counts set bits a word at a time */
+int Mask::count() {
+	int c = 0;
+	for (int w = 0; w < bits.size(); w++) {
+		unsigned int x = bits[w];
+		while (x) {
+			x &= x - 1u;
+			c++;
+		}
+	}
+	return c;
+}
+
+bool Mask::get(int i) {
+	if (i < 0 || i >= n) {
+		throw out_of_range("Mask::get");
+	}
+	return (bits[i / 32] >> (i % 32)) & 1u;
+}
+
+void Mask::set(int i, bool value) {
+	if (i < 0 || i >= n) {
+		throw out_of_range("Mask::set");
+	}
+	if (value) { bits[i / 32] |= 1u << (i % 32); }
+	else { bits[i / 32] &= ~(1u << (i % 32)); }
+}
+
+Mask Mask::operator&(const Mask &other) const {
+	if (n != other.n) {
+		throw runtime_error("Masks cover different numbers of nodes");
+	}
+	Mask m = *this;
+	for (int w = 0; w < bits.size(); w++) {
+		m.bits[w] &= other.bits[w];
+	}
+	return m;
+}
+
+Mask Mask::operator|(const Mask &other) const {
+	if (n != other.n) {
+		throw runtime_error("Masks cover different numbers of nodes");
+	}
+	Mask m = *this;
+	for (int w = 0; w < bits.size(); w++) {
+		m.bits[w] |= other.bits[w];
+	}
+	return m;
+}
+
+Mask Mask::operator~() const {
+	Mask m = *this;
+	for (int w = 0; w < bits.size(); w++) {
+		m.bits[w] = ~bits[w];
+	}
+	if (n % 32 != 0) {
+		m.bits.back() &= (1u << (n % 32)) - 1u;
+	}
+	return m;
+}
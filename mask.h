@@ -0,0 +1,51 @@
+/* mask.h
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Mask class definition
+This object holds a set of nodes in a CoalescentTree, indexed by preorder position.  Masks select tips, 
+and can be combined with &, | and ~ before being applied to a tree or to a TreeView, both of which keep 
+the selected tips and their ancestors.
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MASK_H
+#define MASK_H
+
+#include <vector>
+using std::vector;
+
+class Mask {
+
+public:
+	Mask();									// constructor, empty mask
+	Mask(int,bool);							// mask of size n, with every node set to value
+	
+	int size();								// returns number of nodes covered by mask
+	int count();							// returns number of nodes selected by mask
+	bool get(int);							// is node i selected
+	void set(int,bool);						// select or deselect node i
+	
+	Mask operator&(const Mask &) const;		// nodes selected by both masks
+	Mask operator|(const Mask &) const;		// nodes selected by either mask
+	Mask operator~() const;					// nodes not selected by mask
+											
+private:
+	int n;									// number of nodes
+	vector<unsigned int> bits;				// packed 32 nodes to a word, unused high bits are kept clear
+
+};
+
+#endif
@@ -0,0 +1,100 @@
+/* newickwriter.cpp
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+NewickWriter class implementation
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <sstream>
+using std::ofstream;
+using std::stringstream;
+using std::ios;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include "newickwriter.h"
+#include "coaltree.h"
+
+NewickWriter::NewickWriter(string f, bool n) {
+
+	outputFile = f;
+	nexus = n;
+	batch = 256;
+
+}
+
+/* trees are formatted a batch at a time, each into its own buffer, and written out in order */
+void NewickWriter::write(vector<CoalescentTree> &treelist, vector<double> &problist) {
+
+	ofstream outStream;
+	outStream.open( outputFile.c_str(), ios::out | ios::binary );
+	if (!outStream.is_open()) {
+		throw runtime_error("Unable to open " + outputFile);
+	}
+	
+	if (nexus) {
+		string header = "#NEXUS\n\nBegin trees;\n";
+		outStream.write(header.data(), header.size());
+	}
+	
+	bool probs = (problist.size() == treelist.size());
+
+	vector<string> buffers (batch);
+	for (int start = 0; start < treelist.size(); start += batch) {
+	
+		int count = treelist.size() - start;
+		if (count > batch) { count = batch; }
+		
+		#pragma omp parallel for schedule(dynamic)
+		for (int k = 0; k < count; k++) {
+			string &out = buffers[k];
+			if (nexus) {
+				stringstream ss;
+				ss.precision(10);
+				ss << "tree STATE_" << start + k;
+				if (probs) {
+					ss << " [&lnP=" << problist[start + k] << "]";
+				}
+				ss << " = [&R] ";
+				out = ss.str();
+			}
+			treelist[start + k].printNewick(out);
+			out += '\n';
+		}
+		
+		for (int k = 0; k < count; k++) {
+			outStream.write(buffers[k].data(), buffers[k].size());
+			buffers[k].clear();
+		}
+		
+	}
+	
+	if (nexus) {
+		string footer = "End;\n";
+		outStream.write(footer.data(), footer.size());
+	}
+	
+	outStream.close();
+
+}
@@ -0,0 +1,54 @@
+/* newickwriter.h
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+NewickWriter class definition
+This object writes every tree in a list in annotated NEWICK format, one tree per line, or as a NEXUS trees 
+block in the form written by BEAST, so that manipulated trees can be read by other programs or by PACT 
+itself.  Trees are formatted in batches into memory, in parallel where compiled with OpenMP, and each batch 
+is then written in order.
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NWRITER_H
+#define NWRITER_H
+
+#include <fstream>
+using std::ofstream;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "coaltree.h"
+
+class NewickWriter {
+
+public:
+	NewickWriter(string,bool);				// constructor, takes output file name and whether to write NEXUS
+	
+	void write(vector<CoalescentTree> &, vector<double> &);	// writes every tree, with log probabilities 
+											// if there is one for each tree
+	
+private:
+	string outputFile;
+	bool nexus;
+	int batch;								// number of trees held in memory at once
+
+};
+
+#endif
@@ -21,10 +21,14 @@ You should have received a copy of the GNU General Public License along with PAC
 #include <string>
 using std::string;
 
+#include <vector>
+using std::vector;
+
 #include "node.h"
 
 Node::Node() {
 	number = -1;
+	row = -1;
 	name = "";
 	length = 0.0;
 	time = 0.0;
@@ -41,6 +45,7 @@ Node::Node() {
 
 Node::Node(int n) {
 	number = n;
+	row = -1;
 	name = "";
 	length = 0.0;
 	time = 0.0;
@@ -64,6 +69,7 @@ bool Node::operator==(Node &other) {
 
 /* Get functions */
 int Node::getNumber() { return number; }
+int Node::getRow() { return row; }
 string Node::getName() { return name; }
 double Node::getLength() { return length; }
 double Node::getTime() { return time; }
@@ -71,6 +77,7 @@ string Node::getLabel() { return label; }
 double Node::getX() { return xLoc; }
 double Node::getY() { return yLoc; }
 double Node::getRate() { return rate; }
+int Node::getDimensions() { return 2 + traits.size(); }
 double Node::getXCoord() { return xCoord; }
 double Node::getYCoord() { return yCoord; }
 bool Node::getLeaf() { return leaf; }
@@ -79,6 +86,7 @@ bool Node::getInclude() { return include; }
 
 /* Set functions */
 void Node::setNumber(int n) { number = n; }
+void Node::setRow(int n) { row = n; }
 void Node::setName(string n) { name = n; }
 void Node::setLength(double n) { length = n; }
 void Node::setTime(double n) { time = n; }
@@ -91,3 +99,39 @@ void Node::setYCoord(double n) { yCoord = n; }
 void Node::setLeaf(bool n) { leaf = n; }
 void Node::setTrunk(bool n) { trunk = n; }
 void Node::setInclude(bool n) { include = n; }
+
+/* Trait functions, dimensions beyond x and y are only stored once set */
+double Node::getTrait(int k) {
+	if (k == 0) { return xLoc; }
+	if (k == 1) { return yLoc; }
+	if (k - 2 < traits.size()) { return traits[k-2]; }
+	return 0.0;
+}
+
+void Node::setTrait(int k, double n) {
+	if (k == 0) { xLoc = n; }
+	else if (k == 1) { yLoc = n; }
+	else {
+		if (k - 2 >= traits.size()) { traits.resize(k - 1, 0.0); }
+		traits[k-2] = n;
+	}
+}
+
+/* Discrete traits beyond the label, numbered from 1, unset traits read as "1" like the label */
+string Node::getDiscrete(int k) {
+	if (k - 1 < discretes.size()) { return discretes[k-1]; }
+	return "1";
+}
+
+void Node::setDiscrete(int k, string n) {
+	if (k - 1 >= discretes.size()) { discretes.resize(k, "1"); }
+	discretes[k-1] = n;
+}
+
+vector<string> Node::getDiscretes() { return discretes; }
+void Node::setDiscretes(vector<string> n) { discretes = n; }
+
+void Node::swapLabel(int k) {
+	if (k - 1 >= discretes.size()) { discretes.resize(k, "1"); }
+	label.swap(discretes[k-1]);
+}
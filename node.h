@@ -25,6 +25,9 @@ You should have received a copy of the GNU General Public License along with PAC
 #include <string>
 using std::string;
 
+#include <vector>
+using std::vector;
+
 class Node {
 
 public:
@@ -35,6 +38,7 @@ public:
 	
 	// GET FUNCTIONS
 	int getNumber();
+	int getRow();					// row of kept annotation columns
 	string getName();
 	double getLength();
 	double getTime();
@@ -42,14 +46,19 @@ public:
 	double getX();
 	double getY();
 	double getRate();	
+	int getDimensions();			// count of trait dimensions held, x and y are always held
+	double getTrait(int);			// trait in a dimension, x and y are dimensions 0 and 1, zero where unset
 	double getXCoord();
 	double getYCoord();
 	bool getLeaf();
 	bool getTrunk();
 	bool getInclude();
+	string getDiscrete(int);		// discrete trait beyond the label, numbered from 1
+	vector<string> getDiscretes();
 
 	// SET FUNCTIONS
 	void setNumber(int);
+	void setRow(int);
 	void setName(string);
 	void setLength(double);
 	void setTime(double);
@@ -57,20 +66,27 @@ public:
 	void setX(double);
 	void setY(double);	
 	void setRate(double);		
+	void setTrait(int,double);
 	void setXCoord(double);
 	void setYCoord(double);	
 	void setLeaf(bool);
 	void setTrunk(bool);
 	void setInclude(bool);
+	void setDiscrete(int,string);
+	void setDiscretes(vector<string>);
+	void swapLabel(int);			// exchanges label with a further discrete trait
 																			
 private:
 	int number;						// number of node, must be unique
+	int row;						// row of node in kept annotation columns, -1 unless read from in.trees
 	string name;					// name of node, doesn't have to exist
 	double length;					// length of the branch leading into the node
 	double time;					// date of the node	
 	string label;					// arbitrary label associated with node
+	vector<string> discretes;		// further discrete traits, held apart while the label is studied
 	double xLoc;					// x-axis location of the node
 	double yLoc;					// y-axis location of the node	
+	vector<double> traits;			// trait dimensions beyond x and y, empty unless annotated
 	double rate;					// rate of branch leading into the node
 	double xCoord;					// x-axis coordinate, used for tree drawing
 	double yCoord;					// y-axis coordinate, used for tree drawing	
@@ -47,6 +47,12 @@ Parameters::Parameters() {
 	// default parameter values
 	// leaving value vectors empty purposely
 	burnin = false;
+	thin = false;
+	subsample = false;
+	chain = false;
+	follow = false;
+	output_columns = false;
+	annotation = false;
 	push_times_back = false;
 	reduce_tips = false;
 	renew_trunk = false;
@@ -67,6 +73,9 @@ Parameters::Parameters() {
 	print_tree = false;
 	print_circular_tree = false;	
 	print_all_trees = false;	
+	print_all_trees_archive = false;
+	print_newick = false;
+	print_nexus = false;
 	
 	summary_tmrca = false;		
 	summary_length = false;			
@@ -74,11 +83,13 @@ Parameters::Parameters() {
 	summary_proportions = false;	
 	summary_coal_rates = false;		
 	summary_mig_rates = false;		
+	summary_sub_rates = false;
 	summary_diversity = false;		
 	summary_fst = false;				
 	summary_tajima_d = false;	
 	summary_diffusion_coefficient = false;
 	summary_persistence = false;
+	summary_drift_rate = false;
 	
 	tips_time_to_trunk = false;
 	x_loc_history = false;	
@@ -97,12 +108,20 @@ Parameters::Parameters() {
 	skyline_timetofix = false;
 	skyline_xmean = false;
 	skyline_ymean = false;
+	skyline_traitmean = false;
 	skyline_xdrift = false;	
 	skyline_ratemean = false;
 	skyline_xtrunkdiff = false;	
 	skyline_locsample = false;
 	skyline_locgrid = false;	
+	skyline_locgrid_sparse = false;
+	skyline_locgrid_values.push_back(-2.0);
+	skyline_locgrid_values.push_back(50.0);
+	skyline_locgrid_values.push_back(-6.0);
+	skyline_locgrid_values.push_back(6.0);
+	skyline_locgrid_values.push_back(0.25);
 	skyline_drift_rate_from_tips = false;
+	skyline_explain = false;
 	
 	ordering = false;
 	
@@ -173,6 +192,80 @@ void Parameters::importLine(string line) {
 		}
 	}		
 	
+	if (pstring == "thin") { 
+		if (values.size() == 1 && values[0] >= 1) {
+			thin = true; 
+			thin_values = values;			
+		}
+	}		
+	
+	if (pstring == "subsample") { 
+		if (values.size() == 2 && values[0] >= 1) {
+			subsample = true; 
+			subsample_values = values;			
+		}
+	}		
+	
+	// file names are case sensitive, so are read from the line as written
+	if (pstring.compare(0, 5, "chain") == 0) { 
+		vector<string> words;
+		string word = "";
+		for (string::iterator is = line.begin(); is != line.end() && *is != '#'; is++) {
+			if (*is == ' ' || *is == '\t' || *is == '\r') {
+				if (word.size() > 0) { words.push_back(word); }
+				word = "";
+			}
+			else {
+				word += *is;
+			}
+		}
+		if (word.size() > 0) { words.push_back(word); }
+		if (words.size() >= 2 && words.size() <= 4 && words[0] == "chain") {
+			double count = -1;
+			double interval = -1;
+			if (words.size() >= 3) { count = atof(words[2].c_str()); }
+			if (words.size() >= 4) { interval = atof(words[3].c_str()); }
+			if ((words.size() < 3 || count >= 0) && (words.size() < 4 || interval >= 1)) {
+				chain = true;
+				chain_files.push_back(words[1]);
+				chain_burnins.push_back(count);
+				chain_thins.push_back(interval);
+			}
+		}
+	}		
+	
+	if (pstring == "follow") { 
+		if ((values.size() == 1 || values.size() == 2) && values[0] > 0) {
+			follow = true; 
+			follow_values = values;			
+		}
+	}		
+	
+	if (pstring == "outputcolumns") { 
+		output_columns = true; 
+	}		
+	
+	// keys are case sensitive and may hold any character, so are read from the line as written
+	if (pstring.compare(0, 10, "annotation") == 0) { 
+		vector<string> words;
+		string word = "";
+		for (string::iterator is = line.begin(); is != line.end() && *is != '#'; is++) {
+			if (*is == ' ' || *is == '\t' || *is == '\r') {
+				if (word.size() > 0) { words.push_back(word); }
+				word = "";
+			}
+			else {
+				word += *is;
+			}
+		}
+		if (word.size() > 0) { words.push_back(word); }
+		if (words.size() == 3 && words[0] == "annotation") {
+			annotation = true;
+			annotation_roles.push_back(words[1]);
+			annotation_keys.push_back(words[2]);
+		}
+	}		
+	
 	if (pstring == "pushtimesback") { 
 		if (values.size() == 1 || values.size() == 2) {
 			push_times_back = true; 
@@ -285,6 +378,19 @@ void Parameters::importLine(string line) {
 	if (pstring == "printalltrees") { 
 		print_all_trees = true; 
 	}		
+	
+	if (pstring == "printalltreesarchive") { 
+		print_all_trees = true; 
+		print_all_trees_archive = true; 
+	}		
+	
+	if (pstring == "printnewick") { 
+		print_newick = true; 
+	}		
+	
+	if (pstring == "printnexus") { 
+		print_nexus = true; 
+	}		
 
 	if (pstring == "summarytmrca") { summary_tmrca = true; }
 	if (pstring == "summarylength") { summary_length = true; }
@@ -344,12 +450,22 @@ void Parameters::importLine(string line) {
 	if (pstring == "skylinetimetofix") { skyline_timetofix = true; }
 	if (pstring == "skylinexmean") { skyline_xmean = true; }	
 	if (pstring == "skylineymean") { skyline_ymean = true; }
+	if (pstring == "skylinetraitmean") { skyline_traitmean = true; }
 	if (pstring == "skylinexdrift") { skyline_xdrift = true; }		
 	if (pstring == "skylineratemean") { skyline_ratemean = true; }
 	if (pstring == "skylinextrunkdiff") { skyline_xtrunkdiff = true; }		
 	if (pstring == "skylinelocsample") { skyline_locsample = true; }	
-	if (pstring == "skylinelocgrid") { skyline_locgrid = true; }	
+	if (pstring == "skylinelocgrid" || pstring == "skylinelocgridsparse") { 
+		skyline_locgrid = true; 
+		if (pstring == "skylinelocgridsparse") {
+			skyline_locgrid_sparse = true;
+		}
+		if (values.size() == 5) {
+			skyline_locgrid_values = values;
+		}
+	}	
 	if (pstring == "skylinedriftratefromtips") { skyline_drift_rate_from_tips = true; }		
+	if (pstring == "skylineexplain") { skyline_explain = true; }
 	
 	if (pstring == "pairsdiversity") { 
 		if (values.size() == 1) {
@@ -371,6 +487,35 @@ void Parameters::print() {
 		if (burnin) {
 			cout << "burnin " << burnin_values[0] << endl;
 		}	
+		
+		if (thin) {
+			cout << "thin " << thin_values[0] << endl;
+		}	
+		
+		if (subsample) {
+			cout << "subsample " << subsample_values[0] << " " << subsample_values[1] << endl;
+		}	
+		
+		for (int i = 0; i < chain_files.size(); i++) {
+			cout << "chain " << chain_files[i];
+			if (chain_burnins[i] >= 0) { cout << " " << chain_burnins[i]; }
+			if (chain_thins[i] >= 0) { cout << " " << chain_thins[i]; }
+			cout << endl;
+		}
+		
+		if (follow) {
+			cout << "follow " << follow_values[0];
+			if (follow_values.size() == 2) { cout << " " << follow_values[1]; }
+			cout << endl;
+		}	
+		
+		if (output_columns) {
+			cout << "output columns" << endl;
+		}	
+		
+		for (int i = 0; i < annotation_keys.size(); i++) {
+			cout << "annotation " << annotation_roles[i] << " " << annotation_keys[i] << endl;
+		}	
 	
 		cout << endl;
 	
@@ -475,7 +620,10 @@ void Parameters::print() {
 		cout << "Tree structure:" << endl;
 		if (print_tree) { cout << "print tree" << endl; }
 		if (print_circular_tree) { cout << "print circular tree" << endl; }		
-		if (print_all_trees) { cout << "print all trees" << endl; }
+		if (print_all_trees && !print_all_trees_archive) { cout << "print all trees" << endl; }
+		if (print_all_trees_archive) { cout << "print all trees archive" << endl; }
+		if (print_newick) { cout << "print newick" << endl; }
+		if (print_nexus) { cout << "print nexus" << endl; }
 		cout << endl;
 	}	
 	
@@ -527,12 +675,21 @@ void Parameters::print() {
 		if (skyline_timetofix) { cout << "time to fix" << endl; }
 		if (skyline_xmean) { cout << "x mean" << endl; }
 		if (skyline_ymean) { cout << "y mean" << endl; }
+		if (skyline_traitmean) { cout << "trait mean" << endl; }
 		if (skyline_xdrift) { cout << "x drift" << endl; }		
 		if (skyline_ratemean) { cout << "rate mean" << endl; }	
 		if (skyline_xtrunkdiff) { cout << "x trunk diff" << endl; }
 		if (skyline_locsample) { cout << "loc sample" << endl; }
-		if (skyline_locgrid) { cout << "loc grid" << endl; }	
+		if (skyline_locgrid) { 
+			cout << "loc grid";
+			if (skyline_locgrid_sparse) { cout << " sparse"; }
+			for (int i = 0; i < skyline_locgrid_values.size(); i++) {
+				cout << " " << skyline_locgrid_values[i];
+			}
+			cout << endl;
+		}	
 		if (skyline_drift_rate_from_tips) { cout << "drift rate from tips" << endl; }	
+		if (skyline_explain) { cout << "explain" << endl; }
 		cout << endl;
 	}
 	
@@ -546,7 +703,7 @@ void Parameters::print() {
 
 bool Parameters::general() {
 	bool check;
-	if (burnin)
+	if (burnin || thin || subsample || chain || follow || output_columns || annotation)
 		check = true;
 	else 
 		check = false;
@@ -564,7 +721,7 @@ bool Parameters::manip() {
 
 bool Parameters::printtree() {
 	bool check;
-	if (print_tree || print_circular_tree || print_all_trees)
+	if (print_tree || print_circular_tree || print_all_trees || print_newick || print_nexus)
 		check = true;
 	else 
 		check = false;
@@ -592,7 +749,7 @@ bool Parameters::tips() {
 bool Parameters::skyline() {
 	bool check;
 	if ( skyline_values.size() == 3 &&
-		(skyline_tmrca || skyline_length || skyline_proportions || skyline_coal_rates || skyline_mig_rates || skyline_pro_history_from_tips || skyline_diversity || skyline_fst || skyline_tajima_d || skyline_timetofix || skyline_xmean || skyline_ymean || skyline_xdrift || skyline_ratemean || skyline_xtrunkdiff || skyline_locsample || skyline_locgrid || skyline_drift_rate_from_tips) )
+		(skyline_tmrca || skyline_length || skyline_proportions || skyline_coal_rates || skyline_mig_rates || skyline_pro_history_from_tips || skyline_diversity || skyline_fst || skyline_tajima_d || skyline_timetofix || skyline_xmean || skyline_ymean || skyline_traitmean || skyline_xdrift || skyline_ratemean || skyline_xtrunkdiff || skyline_locsample || skyline_locgrid || skyline_drift_rate_from_tips) )
 		check = true;
 	else 
 		check = false;
@@ -606,4 +763,23 @@ bool Parameters::pairs() {
 	else
 		check = false;
 	return check;
-}
\ No newline at end of file
+}
+
+/* trees are printed with locations, and manipulations of locations are only needed if these are read */
+bool Parameters::traits() {
+	bool check;
+	if (printtree() || rotate || accumulate || summary_diffusion_coefficient || summary_drift_rate || x_loc_history || y_loc_history || skyline_xmean || skyline_ymean || skyline_traitmean || skyline_xdrift || skyline_xtrunkdiff || skyline_locsample || skyline_locgrid || skyline_drift_rate_from_tips)
+		check = true;
+	else 
+		check = false;
+	return check;
+}
+
+bool Parameters::rates() {
+	bool check;
+	if (print_newick || print_nexus || summary_sub_rates || skyline_ratemean)
+		check = true;
+	else 
+		check = false;
+	return check;
+}
@@ -40,12 +40,34 @@ public:
 	bool tips();						// are any of the tip statistics true?
 	bool skyline();						// are any skyline parameters true?
 	bool pairs();						// are any of the pair statistics true?
+	bool traits();						// do any parameters read x, y or further trait dimensions?
+	bool rates();						// do any parameters read rates?
 
 	// PARAMETERS
 	
 	bool burnin;
 	vector<double> burnin_values;			// count
 	
+	bool thin;
+	vector<double> thin_values;				// interval
+	
+	bool subsample;
+	vector<double> subsample_values;		// count, seed
+	
+	bool chain;
+	vector<string> chain_files;				// tree file of each chain, in place of in.trees
+	vector<double> chain_burnins;			// count, -1 where burnin applies
+	vector<double> chain_thins;				// interval, -1 where thin applies
+	
+	bool follow;
+	vector<double> follow_values;			// seconds between checks, checks without new trees before stopping
+	
+	bool output_columns;					// summary and skyline rows also written as columnar tables
+	
+	bool annotation;
+	vector<string> annotation_roles;		// role of each key, as named in in.param
+	vector<string> annotation_keys;			// annotation keys, exactly as written in in.trees
+	
 	bool push_times_back;
 	vector<double> push_times_back_values;	// start, stop
 	
@@ -93,6 +115,9 @@ public:
 	bool print_tree;
 	bool print_circular_tree;	
 	bool print_all_trees;	
+	bool print_all_trees_archive;			// pack all trees into a single indexed archive
+	bool print_newick;						// every tree in annotated NEWICK format
+	bool print_nexus;						// every tree in a NEXUS trees block
 	
 	bool summary_tmrca;		
 	bool summary_length;			
@@ -130,12 +155,16 @@ public:
 	bool skyline_timetofix;
 	bool skyline_xmean;
 	bool skyline_ymean;
+	bool skyline_traitmean;
 	bool skyline_xdrift;
 	bool skyline_ratemean;
 	bool skyline_xtrunkdiff;
 	bool skyline_locsample;	
 	bool skyline_locgrid;		
+	vector<double> skyline_locgrid_values;	// x start, x stop, y start, y stop, step
+	bool skyline_locgrid_sparse;			// print only occupied cells
 	bool skyline_drift_rate_from_tips;
+	bool skyline_explain;					// print plan of skyline statistics rather than computing them
 	
 	bool ordering;
 	vector<string> ordering_values;
@@ -0,0 +1,571 @@
+/* planner.cpp
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Member function definitions for Planner class
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <ostream>
+#include <sstream>
+using std::ostream;
+using std::stringstream;
+using std::endl;
+
+#include <map>
+using std::map;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <cmath>
+using std::log;
+using std::floor;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include "planner.h"
+#include "coaltree.h"
+#include "treeview.h"
+#include "series.h"
+#include "sink.h"
+
+Planner::Planner() {
+	discrete = 0;
+	setGrid(-2.0, 50.0, -6.0, 6.0, 0.25, false);
+}
+
+/* identical cuts share an id */
+int Planner::addCut(CutType type, double start, double stop, bool trunk) {
+
+	stringstream ss;
+	ss.precision(17);
+	ss << type << " " << start << " " << stop << " " << trunk << " " << discrete;
+	string key = ss.str();
+
+	map<string,int>::iterator mt = cutIndex.find(key);
+	if (mt != cutIndex.end()) {
+		return mt->second;
+	}
+
+	int c = cutType.size();
+	cutType.push_back(type);
+	cutStart.push_back(start);
+	cutStop.push_back(stop);
+	cutTrunk.push_back(trunk);
+	cutDiscrete.push_back(discrete);
+	cutMeasures.push_back(vector<int>());
+	cutIndex[key] = c;
+	return c;
+
+}
+
+int Planner::addMeasure(int cut, Quantity quantity) {
+	return addMeasure(cut, quantity, "", "", 0.0, 0.0);
+}
+
+/* identical measures on identical cuts share an id */
+int Planner::addMeasure(int cut, Quantity quantity, string first, string second, double p, double q) {
+
+	stringstream ss;
+	ss.precision(17);
+	ss << cut << " " << quantity << " " << first << " " << second << " " << p << " " << q;
+	string key = ss.str();
+
+	map<string,int>::iterator mt = measureIndex.find(key);
+	if (mt != measureIndex.end()) {
+		return mt->second;
+	}
+
+	int m = measureCut.size();
+	measureCut.push_back(cut);
+	measureQuantity.push_back(quantity);
+	measureFirst.push_back(first);
+	measureSecond.push_back(second);
+	measureP.push_back(p);
+	measureQ.push_back(q);
+	measureValues.push_back(vector<double>());
+	measureTips.push_back(vector< vector<double> >());
+	cutMeasures[cut].push_back(m);
+	measureIndex[key] = m;
+	
+	if (quantity == PROHIST) {
+		string labels[2] = { first, second };
+		for (int j = 0; j < 2; j++) {
+			if (historyLabelIndex.find(labels[j]) == historyLabelIndex.end()) {
+				historyLabelIndex[labels[j]] = historyLabels.size();
+				historyLabels.push_back(labels[j]);
+			}
+		}
+		if (historyTimeIndex.find(p) == historyTimeIndex.end()) {
+			historyTimeIndex[p] = historyTimes.size();
+			historyTimes.push_back(p);
+		}
+	}
+	
+	return m;
+
+}
+
+void Planner::addLine(string name, double time, int measure, int less, double offset, double lower, double upper) {
+
+	lineType.push_back(SERIES);
+	lineName.push_back(name);
+	lineTime.push_back(time);
+	lineMeasure.push_back(measure);
+	lineLess.push_back(less);
+	lineOffset.push_back(offset);
+	lineLower.push_back(lower);
+	lineUpper.push_back(upper);
+
+}
+
+void Planner::addLine(LineType type, string name, double time, int measure) {
+
+	lineType.push_back(type);
+	lineName.push_back(name);
+	lineTime.push_back(time);
+	lineMeasure.push_back(measure);
+	lineLess.push_back(-1);
+	lineOffset.push_back(0.0);
+	lineLower.push_back(0.0);
+	lineUpper.push_back(0.0);
+
+}
+
+void Planner::setDiscrete(int d) {
+	discrete = d;
+}
+
+/* centres are stepped by repeated addition, so that they fall where they always have */
+void Planner::setGrid(double xStart, double xStop, double yStart, double yStop, double step, bool sparse) {
+
+	if (step <= 0.0) {
+		throw runtime_error("Grid step must be positive");
+	}
+
+	gridX.clear();
+	gridY.clear();
+	for (double x = xStart; x <= xStop; x += step) { gridX.push_back(x); }
+	for (double y = yStart; y <= yStop; y += step) { gridY.push_back(y); }
+	gridStep = step;
+	gridSparse = sparse;
+
+}
+
+/* each tree is attached to the view once, each cut is made once, and every measure on the cut is */
+/* taken before moving on, measures on the same cut share the view's tallies */
+void Planner::run(vector<CoalescentTree> &treelist) {
+
+	for (int m = 0; m < measureCut.size(); m++) {
+		measureValues[m].clear();
+		measureTips[m].clear();
+	}
+	run(treelist, 0);
+
+}
+
+/* values of earlier trees are kept, so that trees can be added as they arrive */
+void Planner::run(vector<CoalescentTree> &treelist, int first) {
+
+	vector<int> cuts = schedule();
+
+	for (int i = first; i < treelist.size(); i++) {
+
+		bool attached = false;
+		bool restricted = false;
+		int selected = 0;
+		historied = false;
+
+		for (int k = 0; k < cuts.size(); k++) {
+			int c = cuts[k];
+
+			/* labels are exchanged in the tree and reread by the view, which lifts any restriction */
+			if (cutDiscrete[c] != selected) {
+				selected = cutDiscrete[c];
+				treelist[i].selectDiscrete(selected);
+				if (attached) { view.relabel(); }
+				restricted = false;
+				historied = false;
+			}
+
+			if (cutType[c] != TREE) {
+				if (!attached) {
+					view.attach(treelist[i]);
+					attached = true;
+				}
+				if (cutTrunk[c] && !restricted) {
+					view.pruneToTrunk();
+					restricted = true;
+				}
+				if (cutType[c] == SLICE) { view.timeSlice(cutStart[c]); }
+				if (cutType[c] == TRIM) { view.trimEnds(cutStart[c], cutStop[c]); }
+				if (cutType[c] == TRUNKSLICE) { view.trunkSlice(cutStart[c]); }
+			}
+
+			for (int j = 0; j < cutMeasures[c].size(); j++) {
+				evaluate(cutMeasures[c][j], treelist[i]);
+			}
+		}
+		
+		treelist[i].selectDiscrete(0);
+
+	}
+
+}
+
+void Planner::evaluate(int m, CoalescentTree &ct) {
+
+	string a = measureFirst[m];
+	string b = measureSecond[m];
+	double p = measureP[m];
+	double q = measureQ[m];
+	double n = 0.0;
+
+	switch (measureQuantity[m]) {
+		case TMRCA: n = view.getTMRCA(); break;
+		case LENGTH: n = view.getLength(); break;
+		case LABELPRO: n = view.getLabelPro(a); break;
+		case COALRATE: n = view.getCoalRate(a); break;
+		case MIGRATE:
+			if (a == "") { n = view.getMigRate(); }
+			else { n = view.getMigRate(a,b); }
+			break;
+		case DIVERSITY: n = view.getDiversity(); break;
+		case FST: n = view.getFst(); break;
+		case TAJIMAD: n = view.getTajimaD(); break;
+		case PRESENT: n = view.getPresentTime(); break;
+		case MEANX: n = view.getMeanX(); break;
+		case MEANY: n = view.getMeanY(); break;
+		case MEANTRAIT: n = view.getMeanTrait((int) p); break;
+		case MEANRATE: n = view.getMeanRate(); break;
+		case PROHIST: {
+			if (!historied) {
+				history = ct.getLabelProHistoryFromTips(historyLabels, historyTimes);
+				historied = true;
+			}
+			int L = historyLabels.size();
+			int T = historyTimes.size();
+			n = history[(historyLabelIndex[a] * L + historyLabelIndex[b]) * T + historyTimeIndex[p]];
+			break;
+		}
+		case DRIFT1D: n = ct.get1DRateFromTips(p, q); break;
+		case DRIFT2D: n = ct.get2DRateFromTips(p, q); break;
+		case TIPS: {
+			vector<double> xlocs = view.getTipsX();
+			vector<double> ylocs = view.getTipsY();
+			vector<double> locs;
+			for (int k = 0; k < xlocs.size(); k++) {
+				locs.push_back(xlocs[k]);
+				locs.push_back(ylocs[k]);
+			}
+			measureTips[m].push_back(locs);
+			return;
+		}
+	}
+
+	measureValues[m].push_back(n);
+
+}
+
+void Planner::print(Sink &outStream) {
+	vector<int> chains;
+	print(outStream, chains);
+}
+
+/* chain lines are named chain1_, chain2_ and so on, and are left out when trees come from one chain */
+void Planner::print(Sink &outStream, vector<int> &chains) {
+
+	int chainCount = 0;
+	for (int i = 0; i < chains.size(); i++) {
+		if (chains[i] >= chainCount) { chainCount = chains[i] + 1; }
+	}
+	if (chainCount < 2) { chainCount = 0; }
+
+	for (int l = 0; l < lineType.size(); l++) {
+
+		int m = lineMeasure[l];
+
+		if (lineType[l] == SERIES) {
+			Series s;
+			vector<Series> chainSeries (chainCount);
+			for (int i = 0; i < measureValues[m].size(); i++) {
+				double n = measureValues[m][i];
+				if (lineLess[l] >= 0) {
+					n -= measureValues[lineLess[l]][i];
+				}
+				n -= lineOffset[l];
+				s.insert(n);
+				if (chainCount > 0) {
+					chainSeries[chains[i]].insert(n);
+				}
+			}
+			outStream.row(lineName[l], lineTime[l], s.quantile(lineLower[l]), s.mean(), s.quantile(lineUpper[l]));
+			for (int c = 0; c < chainCount; c++) {
+				stringstream name;
+				name << "chain" << c + 1 << "_" << lineName[l];
+				Series &cs = chainSeries[c];
+				outStream.row(name.str(), lineTime[l], cs.quantile(lineLower[l]), cs.mean(), cs.quantile(lineUpper[l]));
+			}
+		}
+
+		if (lineType[l] == SAMPLE) {
+			outStream << lineName[l] << "\t" << lineTime[l];
+			for (int i = 0; i < measureTips[m].size(); i++) {
+				vector<double> &locs = measureTips[m][i];
+				int length = locs.size() / 2;
+				if (length > 50000) { length = 50000; }
+				for (int k = 0; k < length; k++) {
+					double x = locs[2*k];
+					double y = locs[2*k+1];
+					if (x < 0.001 && x > -0.001) { x = 0.0; }
+					if (y < 0.001 && y > -0.001) { y = 0.0; }
+					outStream << "\t{" << x << "," << y << "}";
+				}
+			}
+			outStream << '\n';
+		}
+
+		/* trees are binned in parallel, each thread into its own counts */
+		if (lineType[l] == GRID) {
+			int X = gridX.size();
+			int Y = gridY.size();
+			int trees = measureTips[m].size();
+			vector<int> counts (X * Y, 0);
+			#pragma omp parallel
+			{
+				vector<int> local (X * Y, 0);
+				#pragma omp for schedule(static)
+				for (int i = 0; i < trees; i++) {
+					bin(measureTips[m][i], local);
+				}
+				#pragma omp critical
+				for (int c = 0; c < X * Y; c++) {
+					counts[c] += local[c];
+				}
+			}
+			outStream << lineName[l] << "\t" << lineTime[l];
+			for (int a = 0; a < X; a++) {
+				for (int b = 0; b < Y; b++) {
+					int count = counts[a * Y + b];
+					if (!gridSparse) {
+						outStream << '\t' << count;
+					}
+					else if (count > 0) {
+						outStream << "\t{" << gridX[a] << "," << gridY[b] << "," << count << "}";
+					}
+				}
+			}
+			outStream << '\n';
+		}
+
+	}
+
+}
+
+/* each point is rounded to its nearest centre, and the neighbouring cells are checked as well, so */
+/* that points falling on an edge are counted exactly as a comparison against every cell would count them */
+void Planner::bin(vector<double> &locs, vector<int> &counts) {
+
+	int X = gridX.size();
+	int Y = gridY.size();
+	if (X == 0 || Y == 0) { return; }
+	double half = 0.5 * gridStep;
+
+	for (int k = 0; k + 1 < locs.size(); k += 2) {
+		double x = locs[k];
+		double y = locs[k+1];
+		if (!(x > gridX[0] - gridStep && x < gridX[X-1] + gridStep)) { continue; }
+		if (!(y > gridY[0] - gridStep && y < gridY[Y-1] + gridStep)) { continue; }
+		int i = (int) floor((x - gridX[0]) / gridStep + 0.5);
+		int j = (int) floor((y - gridY[0]) / gridStep + 0.5);
+		for (int a = i - 1; a <= i + 1; a++) {
+			if (a < 0 || a >= X) { continue; }
+			if (!(x < gridX[a] + half && x > gridX[a] - half)) { continue; }
+			for (int b = j - 1; b <= j + 1; b++) {
+				if (b < 0 || b >= Y) { continue; }
+				if (y < gridY[b] + half && y > gridY[b] - half) {
+					counts[a * Y + b]++;
+				}
+			}
+		}
+	}
+
+}
+
+/* lists cuts in the order they are run, with the measures taken from each and their estimated cost */
+/* cost is counted in node visits per tree, and is compared to evaluating every line separately */
+void Planner::explain(ostream &out, vector<CoalescentTree> &treelist) {
+
+	double n = 0.0;
+	for (int i = 0; i < treelist.size(); i++) {
+		n += treelist[i].getNodeCount();
+	}
+	if (treelist.size() > 0) { n /= (double) treelist.size(); }
+	double L = 1.0;
+	if (treelist.size() > 0) { L = treelist[0].getLabelSet().size(); }
+
+	vector<int> cuts = schedule();
+	out << "Skyline plan: " << cutType.size() << " cuts, " << measureCut.size() << " measures, ";
+	out << lineType.size() << " lines, over " << treelist.size() << " trees of " << (long) n << " nodes" << endl;
+
+	double planned = 0.0;
+	bool attached = false;
+	bool restricted = false;
+	int selected = 0;
+	for (int k = 0; k < cuts.size(); k++) {
+		int c = cuts[k];
+
+		double cutCost = 0.0;
+		if (cutDiscrete[c] != selected) {
+			selected = cutDiscrete[c];
+			cutCost += attached ? 2.0 * n : n;
+			restricted = false;
+		}
+		out << "cut " << c << ": ";
+		if (cutType[c] == TREE) { out << "whole tree"; }
+		if (cutType[c] == SLICE) { out << "time slice at " << cutStart[c]; }
+		if (cutType[c] == TRIM) { out << "trim ends to " << cutStart[c] << " " << cutStop[c]; }
+		if (cutType[c] == TRUNKSLICE) { out << "trunk slice at " << cutStart[c]; }
+		if (cutTrunk[c]) { out << ", pruned to trunk"; }
+		if (cutDiscrete[c] > 0) { out << ", discrete trait " << cutDiscrete[c]; }
+		if (cutType[c] != TREE) {
+			if (!attached) { cutCost += n; attached = true; }
+			if (cutTrunk[c] && !restricted) { cutCost += n; restricted = true; }
+			cutCost += n;
+		}
+		out << "\t[" << (long) cutCost << "]" << endl;
+		planned += cutCost;
+
+		vector<char> done (4, false);
+		for (int j = 0; j < cutMeasures[c].size(); j++) {
+			int m = cutMeasures[c][j];
+			double measureCost = cost(m, n, L, done);
+			out << "\t" << describe(m) << "\t[" << (long) measureCost << "]" << endl;
+			planned += measureCost;
+		}
+	}
+
+	/* without sharing, every line attaches, cuts and measures afresh */
+	double unshared = 0.0;
+	for (int l = 0; l < lineType.size(); l++) {
+		int ms[2] = { lineMeasure[l], lineLess[l] };
+		for (int j = 0; j < 2; j++) {
+			int m = ms[j];
+			if (m < 0) { continue; }
+			int c = measureCut[m];
+			if (cutType[c] != TREE) { unshared += 2.0 * n; }
+			if (cutTrunk[c]) { unshared += n; }
+			vector<char> done (4, false);
+			unshared += cost(m, n, L, done);
+		}
+	}
+
+	out << "Estimated cost: " << (long) planned << " node visits per tree, " << (long) unshared << " without sharing" << endl;
+
+}
+
+/* tree measures need no view, and restricting to trunk lasts until the next attach */
+vector<int> Planner::schedule() {
+
+	int D = 1;
+	for (int c = 0; c < cutType.size(); c++) {
+		if (cutDiscrete[c] + 1 > D) { D = cutDiscrete[c] + 1; }
+	}
+
+	vector<int> cuts;
+	for (int d = 0; d < D; d++) {
+		for (int c = 0; c < cutType.size(); c++) {
+			if (cutDiscrete[c] == d && cutType[c] == TREE) { cuts.push_back(c); }
+		}
+		for (int c = 0; c < cutType.size(); c++) {
+			if (cutDiscrete[c] == d && cutType[c] != TREE && !cutTrunk[c]) { cuts.push_back(c); }
+		}
+		for (int c = 0; c < cutType.size(); c++) {
+			if (cutDiscrete[c] == d && cutType[c] != TREE && cutTrunk[c]) { cuts.push_back(c); }
+		}
+	}
+	return cuts;
+
+}
+
+string Planner::describe(int m) {
+
+	stringstream ss;
+	string a = measureFirst[m];
+	string b = measureSecond[m];
+	switch (measureQuantity[m]) {
+		case TMRCA: ss << "tmrca"; break;
+		case LENGTH: ss << "length"; break;
+		case LABELPRO: ss << "proportion " << a; break;
+		case COALRATE: ss << "coal rate " << a; break;
+		case MIGRATE:
+			if (a == "") { ss << "mig rate"; }
+			else { ss << "mig rate " << a << " to " << b; }
+			break;
+		case DIVERSITY: ss << "diversity"; break;
+		case FST: ss << "fst"; break;
+		case TAJIMAD: ss << "tajima d"; break;
+		case PRESENT: ss << "present time"; break;
+		case MEANX: ss << "x mean"; break;
+		case MEANY: ss << "y mean"; break;
+		case MEANTRAIT: ss << "trait " << (int) measureP[m] + 1 << " mean"; break;
+		case MEANRATE: ss << "rate mean"; break;
+		case TIPS: ss << "tip locations"; break;
+		case PROHIST: ss << "proportion " << b << " from " << a << " tips at " << measureP[m]; break;
+		case DRIFT1D: ss << "1D drift rate from tips at " << measureP[m]; break;
+		case DRIFT2D: ss << "2D drift rate from tips at " << measureP[m]; break;
+	}
+	return ss.str();
+
+}
+
+/* the view gathers counts and lengths, coalescence weights and pairwise diversity in three */
+/* separate passes, each of which is made at most once per cut, and proportion history is a */
+/* single walk back from every tip */
+double Planner::cost(int m, double n, double L, vector<char> &done) {
+
+	double logn = 1.0;
+	if (n > 1.0) { logn = log(n) / log(2.0); }
+
+	bool tally = false;
+	bool weigh = false;
+	bool diversify = false;
+	bool walk = false;
+	double c = 0.0;
+
+	switch (measureQuantity[m]) {
+		case COALRATE: tally = true; weigh = true; break;
+		case DIVERSITY: diversify = true; break;
+		case FST: diversify = true; break;
+		case TAJIMAD: tally = true; diversify = true; break;
+		case TIPS: c += 2.0 * n; break;
+		case PROHIST: walk = true; break;
+		case DRIFT1D: c += n * logn; break;
+		case DRIFT2D: c += n * logn; break;
+		default: tally = true; break;
+	}
+
+	if (tally && !done[0]) { c += n; done[0] = true; }
+	if (weigh && !done[1]) { c += n * logn + 1000.0 * L; done[1] = true; }
+	if (diversify && !done[2]) { c += n * L; done[2] = true; }
+	if (walk && !done[3]) { c += n * logn; done[3] = true; }
+	return c;
+
+}
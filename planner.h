@@ -0,0 +1,137 @@
+/* planner.h
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Planner class definition
+This object turns a set of skyline statistics into a plan of cuts, measures and output lines.  A cut is a
+view of a tree (time slice, trimmed window, trunk slice, or the tree itself), a measure is a quantity taken
+from a cut, and a line is one row of output built from one or two measures.  Identical cuts and measures
+are shared, so that each is evaluated once per tree however many lines depend on it.
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <map>
+using std::map;
+
+#include <ostream>
+using std::ostream;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "coaltree.h"
+#include "treeview.h"
+#include "sink.h"
+
+class Planner {
+
+public:
+	enum CutType { TREE, SLICE, TRIM, TRUNKSLICE };
+	enum Quantity { TMRCA, LENGTH, LABELPRO, COALRATE, MIGRATE, DIVERSITY, FST, TAJIMAD, PRESENT,
+					MEANX, MEANY, MEANTRAIT, MEANRATE, TIPS, PROHIST, DRIFT1D, DRIFT2D };
+	enum LineType { SERIES, SAMPLE, GRID };
+
+	Planner();								// constructor, empty plan
+
+	// BUILDING THE PLAN
+	int addCut(CutType,double,double,bool);	// returns id of cut with type, times and trunk restriction
+	int addMeasure(int,Quantity);			// returns id of quantity taken from cut
+	int addMeasure(int,Quantity,string,string,double,double);	// quantity with labels and times, where needed
+	void addLine(string,double,int,int,double,double,double);	// adds row of output, measure less second
+											// measure (or -1) less offset, printed with lower and upper quantiles
+	void addLine(LineType,string,double,int);	// adds row of tip locations, sampled or gridded
+	void setDiscrete(int);					// cuts added from now on read labels from this discrete trait
+	void setGrid(double,double,double,double,double,bool);	// x range, y range and step of grid cells,
+											// and whether only occupied cells are printed
+
+	// RUNNING THE PLAN
+	void run(vector<CoalescentTree> &);		// evaluates every measure on every tree
+	void run(vector<CoalescentTree> &,int);	// evaluates every measure on trees from this one on, adding
+											// to values of earlier trees
+	void print(Sink &);						// prints lines in the order they were added
+	void print(Sink &, vector<int> &);		// with the chain of each tree, every series line is followed
+											// by the same line for each chain alone
+	void explain(ostream &, vector<CoalescentTree> &);	// prints cuts and measures, with estimated cost
+
+private:
+	// CUTS
+	vector<CutType> cutType;
+	vector<double> cutStart;				// slice time, or start of window
+	vector<double> cutStop;					// end of window
+	vector<bool> cutTrunk;					// cut is taken after restricting to trunk
+	vector<int> cutDiscrete;				// discrete trait selected while cut is taken
+	int discrete;							// discrete trait of cuts being added
+	vector< vector<int> > cutMeasures;		// measures taken from each cut
+	map<string,int> cutIndex;
+
+	// MEASURES
+	vector<int> measureCut;
+	vector<Quantity> measureQuantity;
+	vector<string> measureFirst;			// label arguments
+	vector<string> measureSecond;
+	vector<double> measureP;				// time arguments
+	vector<double> measureQ;
+	vector< vector<double> > measureValues;	// one value per tree
+	vector< vector< vector<double> > > measureTips;	// tip locations per tree, x and y interleaved
+	map<string,int> measureIndex;
+
+	// LINES
+	vector<LineType> lineType;
+	vector<string> lineName;
+	vector<double> lineTime;
+	vector<int> lineMeasure;
+	vector<int> lineLess;
+	vector<double> lineOffset;
+	vector<double> lineLower;
+	vector<double> lineUpper;
+
+	// GRID
+	// cells are centred on points stepped from the start of each range, counting tips strictly within
+	// half a step in both x and y
+	vector<double> gridX;					// cell centres
+	vector<double> gridY;
+	double gridStep;
+	bool gridSparse;
+
+	// PROPORTION HISTORY
+	// every proportion history measure reads from one tensor, filled once per tree
+	vector<string> historyLabels;
+	map<string,int> historyLabelIndex;
+	vector<double> historyTimes;
+	map<double,int> historyTimeIndex;
+	vector<double> history;					// indexed [(start * L + end) * T + time]
+	bool historied;
+
+	TreeView view;
+
+	// HELPER FUNCTIONS
+	vector<int> schedule();					// cuts in the order they are run, grouped by discrete trait,
+											// within each those needing no view first and trunk restricted
+											// cuts last
+	void evaluate(int, CoalescentTree &);	// takes measure from current view, or from tree
+	void bin(vector<double> &, vector<int> &);	// adds interleaved x and y locations to cell counts
+	string describe(int);					// describes measure in words
+	double cost(int, double, double, vector<char> &);	// estimated node visits for measure,
+											// skipping passes already marked as done
+
+};
+
+#endif
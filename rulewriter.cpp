@@ -0,0 +1,147 @@
+/* rulewriter.cpp
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+RuleWriter class implementation
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <sstream>
+using std::ofstream;
+using std::stringstream;
+using std::endl;
+using std::ios;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include "rulewriter.h"
+#include "coaltree.h"
+
+RuleWriter::RuleWriter(string p, bool a) {
+
+	prefix = p;
+	archive = a;
+	ordering = false;
+	batch = 256;
+	offset = 0;
+
+}
+
+void RuleWriter::write(vector<CoalescentTree> &treelist) {
+	ordering = false;
+	writeAll(treelist);
+}
+
+void RuleWriter::write(vector<CoalescentTree> &treelist, vector<string> order) {
+	ordering = true;
+	tipOrdering = order;
+	writeAll(treelist);
+}
+
+/* trees are formatted a batch at a time, each tree independently of the others, */
+/* and written out in order once the batch is complete */
+void RuleWriter::writeAll(vector<CoalescentTree> &treelist) {
+
+	if (archive) {
+		string outputFile = prefix + ".archive";
+		archiveStream.open( outputFile.c_str(), ios::out | ios::binary );
+		if (!archiveStream.is_open()) {
+			throw runtime_error("Unable to open " + outputFile);
+		}
+		offset = 0;
+		offsets.clear();
+		lengths.clear();
+	}
+
+	vector<string> buffers (batch);
+	for (int start = 0; start < treelist.size(); start += batch) {
+	
+		int count = treelist.size() - start;
+		if (count > batch) { count = batch; }
+		
+		#pragma omp parallel for schedule(dynamic)
+		for (int k = 0; k < count; k++) {
+			buffers[k] = format(treelist[start + k]);
+		}
+		
+		for (int k = 0; k < count; k++) {
+			writeTree(start + k, buffers[k]);
+			buffers[k].clear();
+		}
+		
+	}
+	
+	if (archive) {
+		writeIndex();
+	}
+
+}
+
+string RuleWriter::format(CoalescentTree ct) {
+
+	stringstream ss;
+	if (!ordering) {
+		ct.printRuleList(ss, false);
+	}
+	else {
+		ct.printRuleListWithOrdering(ss, tipOrdering);
+	}
+	return ss.str();
+
+}
+
+void RuleWriter::writeTree(int i, string &buffer) {
+
+	if (archive) {
+		archiveStream.write(buffer.data(), buffer.size());
+		offsets.push_back(offset);
+		lengths.push_back(buffer.size());
+		offset += buffer.size();
+	}
+	else {
+		stringstream ss;
+		ss << i;
+		string outputFile = "trees/" + prefix + "_" + ss.str() + ".rules";
+		ofstream outStream;
+		outStream.open( outputFile.c_str(), ios::out | ios::binary );
+		outStream.write(buffer.data(), buffer.size());
+		outStream.close();
+	}
+
+}
+
+/* the index follows the trees, giving the number, byte offset and length of each tree, and the */
+/* last line gives the byte offset of the index itself, so that any tree can be read without the others */
+void RuleWriter::writeIndex() {
+
+	stringstream ss;
+	ss << "index " << offsets.size() << endl;
+	for (int i = 0; i < offsets.size(); i++) {
+		ss << i << " " << offsets[i] << " " << lengths[i] << endl;
+	}
+	ss << offset << endl;
+	string index = ss.str();
+	archiveStream.write(index.data(), index.size());
+	archiveStream.close();
+
+}
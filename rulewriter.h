@@ -0,0 +1,66 @@
+/* rulewriter.h
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+RuleWriter class definition
+This object writes every tree in a list in Mathematica rule list format, either to a file per tree in trees/ 
+or packed together into a single indexed archive.  Trees are laid out and formatted in batches into memory, 
+in parallel where compiled with OpenMP, and each batch is then written in order with one write per tree.
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RWRITER_H
+#define RWRITER_H
+
+#include <fstream>
+using std::ofstream;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "coaltree.h"
+
+class RuleWriter {
+
+public:
+	RuleWriter(string,bool);				// constructor, takes output prefix and whether to write an archive
+	
+	void write(vector<CoalescentTree> &);	// lays out and writes every tree
+	void write(vector<CoalescentTree> &, vector<string>);	// as above, supplying the tip ordering
+
+private:
+	string prefix;							// trees are written to trees/prefix_i.rules or to prefix.archive
+	bool archive;
+	bool ordering;
+	vector<string> tipOrdering;
+	int batch;								// number of trees held in memory at once
+	
+	ofstream archiveStream;
+	long offset;							// bytes written to archive
+	vector<long> offsets;					// index of archive, start and length of each tree
+	vector<long> lengths;
+	
+	// HELPER FUNCTIONS
+	void writeAll(vector<CoalescentTree> &);
+	string format(CoalescentTree);			// rule list of a copy of the tree, layout changes sibling order
+	void writeTree(int, string &);			// writes one formatted tree, to its own file or to the archive
+	void writeIndex();						// closes the archive with an index of trees
+
+};
+
+#endif
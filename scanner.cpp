@@ -0,0 +1,152 @@
+/* scanner.cpp
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Member function definitions for Scanner class
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <istream>
+using std::istream;
+using std::streamoff;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <cstring>
+using std::memchr;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include "scanner.h"
+
+Scanner::Scanner(const string &s) {
+	stream = NULL;
+	remaining = 0;
+	consumed = 0;
+	first = s.data();
+	cur = first;
+	last = first + s.size();
+}
+
+Scanner::Scanner(istream &in, streamoff length) {
+	stream = &in;
+	remaining = length;
+	consumed = 0;
+	buffer.resize(1 << 16);
+	first = &buffer[0];
+	cur = first;
+	last = first;
+}
+
+streamoff Scanner::position() {
+	return consumed + (cur - first);
+}
+
+/* a limited stretch that ends early means the stream was changed while it was read */
+bool Scanner::fill() {
+
+	if (stream == NULL || remaining == 0) {
+		return false;
+	}
+	
+	streamoff want = buffer.size();
+	if (remaining > 0 && remaining < want) {
+		want = remaining;
+	}
+	stream->read(&buffer[0], want);
+	streamoff got = stream->gcount();
+	if (got < want && remaining > 0) {
+		throw runtime_error("tree file changed while reading");
+	}
+	if (remaining > 0) {
+		remaining -= got;
+	}
+	else if (got < want) {
+		remaining = 0;
+	}
+	
+	consumed += last - first;
+	first = &buffer[0];
+	cur = first;
+	last = first + got;
+	return got > 0;
+
+}
+
+bool Scanner::skipLine(streamoff &length) {
+
+	length = 0;
+	while (more()) {
+		const char *p = (const char *) memchr(cur, '\n', last - cur);
+		if (p != NULL) {
+			length += p - cur;
+			cur = p + 1;
+			return true;
+		}
+		length += last - cur;
+		cur = last;
+	}
+	return false;
+
+}
+
+void Scanner::skip(streamoff count) {
+
+	while (count > 0 && more()) {
+		streamoff step = last - cur;
+		if (step > count) {
+			step = count;
+		}
+		cur += step;
+		count -= step;
+	}
+
+}
+
+/* braces hold vectors, whose ',' separate elements rather than entries */
+void Scanner::readEntry(string &value, bool keep) {
+
+	bool braced = false;
+	while (more()) {
+		const char *p = cur;
+		while (p < last) {
+			char c = *p;
+			if (braced) {
+				if (c == '}') { braced = false; }
+			}
+			else if (c == '{') {
+				braced = true;
+			}
+			else if (c == ',' || c == ']') {
+				break;
+			}
+			p++;
+		}
+		if (keep) {
+			value.append(cur, p - cur);
+		}
+		bool ended = p < last;
+		cur = p;
+		if (ended) {
+			return;
+		}
+	}
+
+}
@@ -0,0 +1,70 @@
+/* scanner.h
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Scanner class definition
+This object hands out the characters of a string, or of a stretch of an input stream, one at a time.  Streams
+are read a block at a time into a fixed buffer, so that a tree line is never held in memory whole.  The
+character functions are defined here, so that they are inlined into the loops that call them.
+*/
+
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <istream>
+using std::istream;
+using std::streamoff;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+class Scanner {
+
+public:
+	Scanner(const string &);				// constructor, reads the characters of string in place
+	Scanner(istream &, streamoff);			// constructor, reads this many characters from the current
+											// position of stream, or to its end if negative
+
+	bool more() { return cur < last || fill(); }	// are any characters left?
+	char peek() { return *cur; }			// next character, called after more()
+	char get() { return *cur++; }			// next character, moving past it, called after more()
+	streamoff position();					// count of characters moved past
+	void skip(streamoff);					// moves past this many characters, or to the end
+	
+	bool skipLine(streamoff &);				// moves past the rest of the line and its '\n', with the count of
+											// characters before the '\n', returns false if input ends first
+	void readEntry(string &, bool);			// moves up to the ',' or ']' ending an annotation entry, passing
+											// over braces, and optionally appends the characters to string
+
+private:
+	istream *stream;						// NULL when reading a string
+	streamoff remaining;					// characters of stream not yet buffered, negative if unlimited
+	streamoff consumed;						// characters of earlier buffers
+	vector<char> buffer;
+	const char *first;						// current buffer or string
+	const char *cur;
+	const char *last;
+	
+	bool fill();							// reads the next block of stream, returns false at the end
+
+};
+
+#endif
@@ -52,6 +52,11 @@ void Series::clear() {
 	values.clear();
 }
 
+/* returns count of stored values */
+int Series::size() {
+	return values.size();
+}
+
 /* returns value at position n */
 double Series::at(int n) {
 
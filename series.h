@@ -32,6 +32,7 @@ public:
 	
 	void insert(double);					// inserts a value into the growing set
 	void clear();							// clears all stored values
+	int size();								// returns count of stored values
 	
 	double at(int);							
 	double mean();							// returns arithmetic mean of stored values 
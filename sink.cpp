@@ -0,0 +1,258 @@
+/* sink.cpp
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Sink class implementation
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#include <fstream>
+using std::ofstream;
+using std::ios;
+
+#include <map>
+using std::map;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <cstdio>
+using std::snprintf;
+
+#include <cstring>
+using std::strncpy;
+using std::memset;
+
+#include <limits>
+using std::numeric_limits;
+
+#include <stdint.h>
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include <charconv>
+#ifdef __cpp_lib_to_chars
+using std::to_chars;
+using std::to_chars_result;
+using std::chars_format;
+#endif
+
+#include "sink.h"
+
+/* text is held until there is this much of it */
+static const size_t BLOCK = 1 << 16;
+
+Sink::Sink(string textFile) {
+	textStream.open(textFile.c_str(), ios::app);
+	if (!textStream) {
+		throw runtime_error("Unable to open " + textFile);
+	}
+	open = true;
+	tabled = false;
+}
+
+Sink::Sink(string textFile, string t) {
+	textStream.open(textFile.c_str(), ios::app);
+	if (!textStream) {
+		throw runtime_error("Unable to open " + textFile);
+	}
+	open = true;
+	tabled = (t != "");
+	tableFile = t;
+}
+
+Sink::~Sink() {
+	if (open) {
+		close();
+	}
+}
+
+Sink & Sink::operator<<(const string &s) {
+	buffer += s;
+	flush();
+	return *this;
+}
+
+Sink & Sink::operator<<(const char *s) {
+	buffer += s;
+	flush();
+	return *this;
+}
+
+Sink & Sink::operator<<(char c) {
+	buffer += c;
+	return *this;
+}
+
+Sink & Sink::operator<<(int n) {
+	char digits[16];
+	int length = snprintf(digits, sizeof(digits), "%d", n);
+	buffer.append(digits, length);
+	return *this;
+}
+
+/* six significant digits, as printed by an ostream with default settings */
+Sink & Sink::operator<<(double x) {
+	char digits[32];
+#ifdef __cpp_lib_to_chars
+	to_chars_result result = to_chars(digits, digits + sizeof(digits), x, chars_format::general, 6);
+	buffer.append(digits, result.ptr - digits);
+#else
+	int length = snprintf(digits, sizeof(digits), "%g", x);
+	buffer.append(digits, length);
+#endif
+	flush();
+	return *this;
+}
+
+void Sink::row(string statistic, double lower, double mean, double upper) {
+	*this << statistic << '\t' << lower << '\t' << mean << '\t' << upper << '\n';
+	if (tabled) {
+		tableRow(statistic, numeric_limits<double>::quiet_NaN(), lower, mean, upper);
+	}
+}
+
+void Sink::row(string statistic, double time, double lower, double mean, double upper) {
+	*this << statistic << '\t' << time << '\t' << lower << '\t' << mean << '\t' << upper << '\n';
+	if (tabled) {
+		tableRow(statistic, time, lower, mean, upper);
+	}
+}
+
+void Sink::close() {
+
+	textStream.write(buffer.data(), buffer.size());
+	buffer.clear();
+	textStream.close();
+	if (tabled) {
+		writeTable();
+	}
+	open = false;
+
+}
+
+void Sink::flush() {
+	if (buffer.size() >= BLOCK) {
+		textStream.write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+}
+
+void Sink::tableRow(string statistic, double time, double lower, double mean, double upper) {
+
+	map<string,int>::iterator is = statisticIndex.find(statistic);
+	int code;
+	if (is == statisticIndex.end()) {
+		code = statistics.size();
+		statisticIndex[statistic] = code;
+		statistics.push_back(statistic);
+	}
+	else {
+		code = is->second;
+	}
+	
+	codes.push_back(code);
+	times.push_back(time);
+	lowers.push_back(lower);
+	means.push_back(mean);
+	uppers.push_back(upper);
+
+}
+
+/* appends raw bytes of a value */
+template <class T>
+static void put(string &out, T value) {
+	out.append((const char *) &value, sizeof(T));
+}
+
+static void align(string &out) {
+	while (out.size() % 8 != 0) {
+		out += '\0';
+	}
+}
+
+/* data blocks are built first, so that the column descriptors can give their offsets */
+void Sink::writeTable() {
+
+	const int columns = 5;
+	const uint64_t headerSize = 8 + 8 + 8 + columns * 48;
+	uint64_t rows = codes.size();
+
+	string data;
+	uint64_t offsets[columns];
+	uint64_t sizes[columns];
+	uint64_t dictionary;
+	
+	// statistic codes, followed by their dictionary
+	offsets[0] = data.size();
+	for (int r = 0; r < rows; r++) {
+		put(data, (int32_t) codes[r]);
+	}
+	sizes[0] = data.size() - offsets[0];
+	align(data);
+	dictionary = data.size();
+	put(data, (uint64_t) statistics.size());
+	uint64_t position = 0;
+	put(data, position);
+	for (int s = 0; s < statistics.size(); s++) {
+		position += statistics[s].size();
+		put(data, position);
+	}
+	for (int s = 0; s < statistics.size(); s++) {
+		data += statistics[s];
+	}
+	align(data);
+	
+	// time, lower, mean and upper
+	vector<double> *values[4] = { &times, &lowers, &means, &uppers };
+	for (int c = 1; c < columns; c++) {
+		offsets[c] = data.size();
+		if (rows > 0) {
+			data.append((const char *) &(*values[c-1])[0], rows * sizeof(double));
+		}
+		sizes[c] = data.size() - offsets[c];
+	}
+	
+	const char *names[columns] = { "statistic", "time", "lower", "mean", "upper" };
+	string header = "PACTCOLS";
+	put(header, rows);
+	put(header, (uint64_t) columns);
+	for (int c = 0; c < columns; c++) {
+		char name[16];
+		memset(name, 0, sizeof(name));
+		strncpy(name, names[c], sizeof(name) - 1);
+		header.append(name, sizeof(name));
+		put(header, (uint32_t) (c == 0 ? 1 : 2));
+		put(header, (uint32_t) 0);
+		put(header, headerSize + offsets[c]);
+		put(header, sizes[c]);
+		put(header, (uint64_t) (c == 0 ? headerSize + dictionary : 0));
+	}
+	
+	ofstream tableStream;
+	tableStream.open(tableFile.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!tableStream) {
+		throw runtime_error("Unable to open " + tableFile);
+	}
+	tableStream.write(header.data(), header.size());
+	tableStream.write(data.data(), data.size());
+	tableStream.close();
+
+}
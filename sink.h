@@ -0,0 +1,93 @@
+/* sink.h
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Sink class definition
+This object receives the rows of an output file.  Text is formatted into a buffer, with numbers written as 
+an ostream would write them by default, and appended to the file in large blocks.  Rows of statistic, time,
+lower, mean and upper may also be collected into a columnar binary table, written when the sink is closed.
+
+The table is little-endian and laid out so that it can be mapped directly:
+	char[8]		"PACTCOLS"
+	uint64		number of rows
+	uint64		number of columns
+	per column	char[16] name, uint32 type, uint32 zero, uint64 offset, uint64 bytes, uint64 dictionary offset
+	data		each block starts on an 8 byte boundary, offsets count from the start of the file
+Type 1 columns hold an int32 code per row, indexing a dictionary of uint64 count, count + 1 uint64 offsets 
+into the bytes that follow, and the bytes of each string.  Type 2 columns hold a float64 per row.  Rows
+without a time, as in the summary statistics, have a time of NaN.
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SINK_H
+#define SINK_H
+
+#include <fstream>
+using std::ofstream;
+
+#include <map>
+using std::map;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+class Sink {
+
+public:
+	Sink(string);							// appends text to file
+	Sink(string,string);					// appends text to file, and writes rows as a table to second file,
+											// unless it is empty
+	~Sink();								// closes sink if still open
+	
+	// TEXT
+	Sink & operator<<(const string &);
+	Sink & operator<<(const char *);
+	Sink & operator<<(char);
+	Sink & operator<<(int);
+	Sink & operator<<(double);
+	
+	// ROWS
+	// printed as tab-delimited text, and added to the table if there is one
+	void row(string,double,double,double);			// statistic, lower, mean and upper
+	void row(string,double,double,double,double);	// statistic, time, lower, mean and upper
+	
+	void close();							// writes remaining text and the table
+	
+private:
+	ofstream textStream;
+	string buffer;							// text not yet written
+	bool open;
+	
+	bool tabled;
+	string tableFile;
+	vector<string> statistics;				// dictionary of statistic names, in order of first appearance
+	map<string,int> statisticIndex;
+	vector<int> codes;						// one per row
+	vector<double> times;
+	vector<double> lowers;
+	vector<double> means;
+	vector<double> uppers;
+	
+	void flush();							// writes buffer to file once it is large
+	void tableRow(string,double,double,double,double);
+	void writeTable();
+
+};
+
+#endif
@@ -0,0 +1,194 @@
+/* splitter.cpp
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Member function definitions for Splitter class
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+using std::ifstream;
+using std::ios;
+
+#include <istream>
+using std::streamoff;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include "splitter.h"
+#include "scanner.h"
+
+/* a chunk may start inside brackets, which is known once a bracket is met, so parentheses are first taken 
+   to be outside and are dropped if the first bracket met is a ']', a chunk without brackets is resolved in 
+   the running sum */
+/* on each path from the root, the first subtree no longer than the size asked for is taken, and subtrees much
+   smaller than this are left to be parsed along with the rest of the tree */
+Splitter::Splitter(string f, streamoff o, streamoff l, int pieces) {
+
+	file = f;
+	offset = o;
+	length = l;
+	if (pieces < 2 || length < pieces) {
+		return;
+	}
+	
+	// SCAN CHUNKS
+	// parentheses are listed by position, closing ones as -1 - position
+	int chunks = pieces;
+	streamoff step = (length + chunks - 1) / chunks;
+	vector< vector<streamoff> > parens (chunks);
+	vector<int> depths (chunks, 0);			// depth at end of chunk, from zero at its start
+	vector<int> lowest (chunks, 0);			// least depth within chunk, from zero at its start
+	vector<char> ends (chunks, 0);			// last bracket in chunk, 0 if none
+	vector<string> errors (chunks);
+	
+	#pragma omp parallel for schedule(dynamic)
+	for (int k = 0; k < chunks; k++) {
+		try {
+			streamoff from = k * step;
+			streamoff to = from + step;
+			if (to > length) { to = length; }
+			if (from >= to) { continue; }
+			ifstream inStream;
+			inStream.open(file.c_str(), ios::in | ios::binary);
+			inStream.seekg(offset + from);
+			Scanner scanner (inStream, to - from);
+			bool inside = false;
+			while (scanner.more()) {
+				char c = scanner.get();
+				if (c == '[') {
+					inside = true;
+					ends[k] = c;
+				}
+				else if (c == ']') {
+					if (!inside && ends[k] == 0) {
+						parens[k].clear();
+						depths[k] = 0;
+						lowest[k] = 0;
+					}
+					inside = false;
+					ends[k] = c;
+				}
+				else if (!inside && c == '(') {
+					parens[k].push_back(from + scanner.position() - 1);
+					depths[k]++;
+				}
+				else if (!inside && c == ')') {
+					parens[k].push_back(-from - scanner.position());
+					depths[k]--;
+					if (depths[k] < lowest[k]) { lowest[k] = depths[k]; }
+				}
+			}
+		}
+		catch (runtime_error &e) {
+			errors[k] = e.what();
+		}
+	}
+	for (int k = 0; k < chunks; k++) {
+		if (errors[k].size() > 0) {
+			throw runtime_error(errors[k]);
+		}
+	}
+	
+	// RUNNING SUM
+	// bracket state and depth carried from chunk to chunk, giving up on unmatched parentheses
+	bool inside = false;
+	int depth = 0;
+	for (int k = 0; k < chunks; k++) {
+		if (ends[k] == 0 && inside) {
+			parens[k].clear();
+			depths[k] = 0;
+			lowest[k] = 0;
+		}
+		if (ends[k] != 0) {
+			inside = ends[k] == '[';
+		}
+		if (depth + lowest[k] < 0) {
+			return;
+		}
+		depth += depths[k];
+	}
+	if (depth != 0) {
+		return;
+	}
+	
+	// MATCH PARENTHESES
+	vector<streamoff> open;
+	vector<streamoff> opened;				// opening parentheses, in the order they are closed
+	vector<streamoff> closed;
+	for (int k = 0; k < chunks; k++) {
+		for (int p = 0; p < parens[k].size(); p++) {
+			streamoff at = parens[k][p];
+			if (at >= 0) {
+				open.push_back(at);
+			}
+			else {
+				opened.push_back(open.back());
+				closed.push_back(-1 - at);
+				open.pop_back();
+			}
+		}
+		vector<streamoff>().swap(parens[k]);
+	}
+	
+	// PICK SUBTREES
+	// walking back from the last closed meets every subtree before those it encloses, and a subtree is 
+	// taken if it fits and lies wholly before the last taken
+	streamoff most = (length + pieces - 1) / pieces;
+	streamoff least = most / 16;
+	vector<int> order;
+	for (int s = opened.size() - 1; s >= 0; s--) {
+		streamoff size = closed[s] - opened[s] + 1;
+		if (size <= most && size >= least && (order.size() == 0 || closed[s] < opened[order.back()])) {
+			order.push_back(s);
+		}
+	}
+	for (int j = order.size() - 1; j >= 0; j--) {
+		starts.push_back(opened[order[j]]);
+		lengths.push_back(closed[order[j]] - opened[order[j]] + 1);
+	}
+
+}
+
+string Splitter::getFile() {
+	return file;
+}
+
+streamoff Splitter::getOffset() {
+	return offset;
+}
+
+streamoff Splitter::getLength() {
+	return length;
+}
+
+int Splitter::size() {
+	return starts.size();
+}
+
+streamoff Splitter::getStart(int k) {
+	return starts[k];
+}
+
+streamoff Splitter::getLength(int k) {
+	return lengths[k];
+}
@@ -0,0 +1,60 @@
+/* splitter.h
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Splitter class definition
+This object finds subtrees of a single tree line that can be parsed apart.  The line is cut into chunks that
+are scanned in parallel for parentheses outside of brackets, the depth reached at the start of each chunk
+is found by a running sum over chunks, and parentheses are then matched to pick out subtrees of about the
+size asked for.
+*/
+
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPLITTER_H
+#define SPLITTER_H
+
+#include <istream>
+using std::streamoff;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+class Splitter {
+
+public:
+	Splitter(string, streamoff, streamoff, int);	// constructor, scans tree at offset of file with length, for
+											// about this many subtrees
+
+	string getFile();
+	streamoff getOffset();					// offset of tree in file
+	streamoff getLength();					// length of tree
+	int size();								// count of subtrees found, none if parentheses are unmatched
+	streamoff getStart(int);				// position of the '(' opening subtree, from start of tree
+	streamoff getLength(int);				// characters of subtree, up to and including its ')'
+
+private:
+	string file;
+	streamoff offset;
+	streamoff length;
+	vector<streamoff> starts;				// subtrees in the order they are written, none inside another
+	vector<streamoff> lengths;
+
+};
+
+#endif
@@ -0,0 +1,174 @@
+/* summary.cpp
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Member function definitions for Summary class
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <sstream>
+using std::stringstream;
+
+#include <cmath>
+using std::sqrt;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include "summary.h"
+#include "series.h"
+#include "sink.h"
+
+Summary::Summary() {
+	current = 0;
+	chain = -1;
+}
+
+void Summary::nextTree() {
+	current = 0;
+	chain = -1;
+}
+
+void Summary::nextTree(int c) {
+	current = 0;
+	chain = c;
+	if (chain >= chainValues.size()) {
+		chainValues.resize(chain + 1);
+		chainLowers.resize(chain + 1);
+		chainUppers.resize(chain + 1);
+	}
+}
+
+void Summary::add(string name, double value) {
+	add(name, value, 0.025, 0.975);
+}
+
+void Summary::add(string name, double value, double lowerQuantile, double upperQuantile) {
+	int r = nextRow(name, lowerQuantile, upperQuantile, false);
+	values[r].insert(value);
+	if (chain >= 0) {
+		chainValues[chain][r].insert(value);
+	}
+}
+
+void Summary::addRange(string name, double lower, double value, double upper) {
+	int r = nextRow(name, 0.0, 0.0, true);
+	lowers[r].insert(lower);
+	values[r].insert(value);
+	uppers[r].insert(upper);
+	if (chain >= 0) {
+		chainLowers[chain][r].insert(lower);
+		chainValues[chain][r].insert(value);
+		chainUppers[chain][r].insert(upper);
+	}
+}
+
+/* rows appear in the order in which they were first added */
+/* with several chains, each row is followed by the same row for every chain, as chain1_tmrca, and by */
+/* the potential scale reduction factor of the means, as rhat_tmrca */
+void Summary::print(Sink &out) {
+
+	for (int c = 0; c < chainValues.size(); c++) {
+		chainValues[c].resize(names.size());
+		chainLowers[c].resize(names.size());
+		chainUppers[c].resize(names.size());
+	}
+
+	for (int r = 0; r < names.size(); r++) {
+		printRow(out, names[r], r, lowers[r], values[r], uppers[r]);
+		if (chainValues.size() > 1) {
+			for (int c = 0; c < chainValues.size(); c++) {
+				stringstream name;
+				name << "chain" << c + 1 << "_" << names[r];
+				printRow(out, name.str(), r, chainLowers[c][r], chainValues[c][r], chainUppers[c][r]);
+			}
+			double rhat = getRhat(r);
+			out.row("rhat_" + names[r], rhat, rhat, rhat);
+		}
+	}
+
+}
+
+void Summary::printRow(Sink &out, string name, int r, Series &lower, Series &value, Series &upper) {
+	if (ranged[r]) {
+		out.row(name, lower.mean(), value.mean(), upper.mean());
+	}
+	else {
+		out.row(name, value.quantile(lowerQuantiles[r]), value.mean(), value.quantile(upperQuantiles[r]));
+	}
+}
+
+/* the pooled variance, from the mean variance within chains and the variance of chain means, over */
+/* the mean variance within chains, with chains of unequal length taken at their mean length */
+double Summary::getRhat(int r) {
+
+	int chains = chainValues.size();
+	double n = 0.0;
+	double within = 0.0;
+	double grand = 0.0;
+	for (int c = 0; c < chains; c++) {
+		double sd = chainValues[c][r].sd();
+		n += chainValues[c][r].size();
+		within += sd * sd;
+		grand += chainValues[c][r].mean();
+	}
+	n /= chains;
+	within /= chains;
+	grand /= chains;
+	double between = 0.0;
+	for (int c = 0; c < chains; c++) {
+		double d = chainValues[c][r].mean() - grand;
+		between += d * d;
+	}
+	between /= chains - 1;
+	
+	return sqrt(((n - 1.0) / n * within + between) / within);
+
+}
+
+/* every tree must add the same statistics in the same order */
+int Summary::nextRow(string name, double lowerQuantile, double upperQuantile, bool isRanged) {
+
+	int r = current;
+	current++;
+	
+	if (chain >= 0 && r >= chainValues[chain].size()) {
+		chainValues[chain].resize(r + 1);
+		chainLowers[chain].resize(r + 1);
+		chainUppers[chain].resize(r + 1);
+	}
+	
+	if (r == names.size()) {
+		names.push_back(name);
+		values.push_back(Series());
+		lowers.push_back(Series());
+		uppers.push_back(Series());
+		lowerQuantiles.push_back(lowerQuantile);
+		upperQuantiles.push_back(upperQuantile);
+		ranged.push_back(isRanged);
+	}
+	else if (r > names.size() || names[r] != name) {
+		throw runtime_error("Summary statistics added out of order: " + name);
+	}
+	
+	return r;
+
+}
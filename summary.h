@@ -0,0 +1,72 @@
+/* summary.h
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Summary class definition
+This object holds a table of summary statistics, one row per statistic.  Every statistic requested is 
+evaluated on a tree before moving on to the next tree, so rows are revisited in the same order for each 
+tree.  Each row collects its values in a Series and is printed as lower, mean and upper.
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General 
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General 
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see 
+<http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "series.h"
+#include "sink.h"
+
+class Summary {
+
+public:
+	Summary();								// constructor, empty table
+
+	void nextTree();						// starts again from the first row
+	void nextTree(int);						// starts again from the first row, values are also kept for
+											// the chain of the tree, numbered from 0
+	void add(string,double);				// adds a value to the next row, printed with 2.5% and 97.5% quantiles
+	void add(string,double,double,double);	// adds a value to the next row, printed with the given quantiles
+	void addRange(string,double,double,double);	// adds lower, mean and upper to the next row, each 
+											// printed as its mean across trees
+	void print(Sink &);						// prints one row of lower, mean and upper per statistic, with
+											// several chains followed by one row per chain and a row of the
+											// potential scale reduction factor across chains
+	
+private:
+	int current;							// next row to be filled
+	vector<string> names;
+	vector<Series> values;
+	vector<Series> lowers;					// only used by ranged rows
+	vector<Series> uppers;
+	vector<double> lowerQuantiles;
+	vector<double> upperQuantiles;
+	vector<bool> ranged;
+	int chain;								// chain of current tree, -1 if chains are not kept
+	vector< vector<Series> > chainValues;	// indexed [chain][row]
+	vector< vector<Series> > chainLowers;
+	vector< vector<Series> > chainUppers;
+	
+	int nextRow(string,double,double,bool);	// returns index of next row, creating it on the first tree
+	void printRow(Sink &,string,int,Series &,Series &,Series &);	// prints row from these values
+	double getRhat(int);					// Gelman-Rubin statistic of row across chains
+
+};
+
+#endif
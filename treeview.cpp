@@ -0,0 +1,1106 @@
+/* treeview.cpp
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+Member function definitions for TreeView class
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+using std::map;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <algorithm>
+using std::sort;
+using std::reverse;
+
+#include <cmath>
+using std::sqrt;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include "treeview.h"
+#include "coaltree.h"
+#include "mask.h"
+#include "tree.hh"
+#include "node.h"
+
+TreeView::TreeView() {
+	source = 0;
+	sliceTime = 0.0;
+	sliced = false;
+	viewBegin = -1;
+	invalidate();
+}
+
+/* flattens tree into parallel arrays in preorder, recording the index of each node's parent */
+void TreeView::attach(CoalescentTree &ct) {
+
+	time.clear();
+	length.clear();
+	rate.clear();
+	label.clear();
+	leaf.clear();
+	trunk.clear();
+	include.clear();
+
+	source = &ct;
+	ct.flatten(nodes, parent);
+	
+	/* each trait dimension is a contiguous column */
+	int D = ct.getDimensions();
+	traits.resize(D);
+	for (int k = 0; k < D; k++) {
+		traits[k].resize(nodes.size());
+		for (int i = 0; i < nodes.size(); i++) {
+			traits[k][i] = (*nodes[i]).getTrait(k);
+		}
+	}
+
+	for (int i = 0; i < nodes.size(); i++) {
+
+		tree<Node>::iterator it = nodes[i];
+		time.push_back( (*it).getTime() );
+		length.push_back( (*it).getLength() );
+		rate.push_back( (*it).getRate() );
+		leaf.push_back( (*it).getLeaf() );
+		trunk.push_back( (*it).getTrunk() );
+		include.push_back( (*it).getInclude() );
+
+		label.push_back( addLabel((*it).getLabel()) );
+
+	}
+
+	int n = parent.size();
+	order.resize(n);
+	effParent.resize(n);
+	effLength.resize(n);
+	for (int i = 0; i < n; i++) {
+		order[i] = i;
+		effParent[i] = parent[i];
+		effLength[i] = length[i];
+	}
+
+	inView.resize(n);
+	isCut.resize(n);
+	viewParent.resize(n);
+	viewTime.resize(n);
+	viewLength.resize(n);
+	viewLeaf.resize(n);
+	viewInclude.resize(n);
+	viewChildren.resize(n);
+	count.resize(n);
+	child.resize(n);
+	flag.resize(n);
+
+	whole();
+
+}
+
+/* rereads labels of the attached tree, leaving the other columns as they are */
+/* restrictions are lifted, as merging nodes depends on their labels */
+void TreeView::relabel() {
+
+	for (int i = 0; i < nodes.size(); i++) {
+		label[i] = addLabel( (*nodes[i]).getLabel() );
+	}
+
+	int n = parent.size();
+	order.resize(n);
+	for (int i = 0; i < n; i++) {
+		order[i] = i;
+		effParent[i] = parent[i];
+		effLength[i] = length[i];
+	}
+
+	whole();
+
+}
+
+/* keeps tips selected by mask and their ancestors, and merges pointless nodes */
+/* this presents tree as CoalescentTree::pruneToMask would leave it */
+void TreeView::pruneToMask(Mask mask) {
+
+	markMasked(mask);
+	restrict(true);
+
+}
+
+/* keeps trunk and merges pointless nodes */
+void TreeView::pruneToTrunk() {
+
+	pruneToMask( source->getTrunkMask() );
+
+}
+
+/* keeps named tip and its ancestors, without merging */
+void TreeView::pruneToName(string name) {
+
+	markMasked( source->getNameMask(name) );
+	restrict(false);
+
+}
+
+/* flags tips selected by mask that survive restrictions so far, along with their ancestors */
+void TreeView::markMasked(Mask mask) {
+
+	if (mask.size() != nodes.size()) {
+		throw runtime_error("Mask does not match tree");
+	}
+
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		flag[i] = mask.get(i) && leaf[i];
+	}
+	for (int k = order.size() - 1; k >= 0; k--) {
+		int i = order[k];
+		if (flag[i] && effParent[i] >= 0) {
+			flag[effParent[i]] = true;
+		}
+	}
+
+}
+
+/* drops nodes not marked in flag, along with their descendants */
+/* if merge is set, nodes with a single child of the same label are passed over, as reduce() would */
+void TreeView::restrict(bool merge) {
+
+	int kept = 0;
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		int p = effParent[i];
+		if (flag[i] && (p < 0 || flag[p])) { order[kept++] = i; }
+		else { flag[i] = false; }
+	}
+	order.resize(kept);
+
+	if (merge) {
+
+		/* find nodes with a single child of the same label, these are dropped */
+		for (int k = 0; k < order.size(); k++) {
+			count[order[k]] = 0;
+		}
+		for (int k = 0; k < order.size(); k++) {
+			int i = order[k];
+			int p = effParent[i];
+			if (p >= 0) {
+				count[p]++;
+				child[p] = i;
+			}
+		}
+		for (int k = 0; k < order.size(); k++) {
+			int i = order[k];
+			flag[i] = !(effParent[i] >= 0 && count[i] == 1 && label[child[i]] == label[i]);
+		}
+
+		/* children of dropped nodes take their length and their parent */
+		/* working in preorder means that chains of dropped nodes accumulate from the top */
+		kept = 0;
+		for (int k = 0; k < order.size(); k++) {
+			int i = order[k];
+			int p = effParent[i];
+			if (p >= 0 && !flag[p]) {
+				effLength[i] = effLength[i] + effLength[p];
+				effParent[i] = effParent[p];
+			}
+			if (flag[i]) { order[kept++] = i; }
+		}
+		order.resize(kept);
+
+	}
+
+	whole();
+
+}
+
+/* presents every node that survived restrictions */
+void TreeView::whole() {
+
+	invalidate();
+	sliced = false;
+	viewBegin = -1;
+
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		inView[i] = true;
+		isCut[i] = false;
+		viewParent[i] = effParent[i];
+		viewTime[i] = time[i];
+		viewLength[i] = effLength[i];
+		viewLeaf[i] = leaf[i];
+		viewInclude[i] = include[i];
+		viewChildren[i] = 0;
+	}
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		int p = viewParent[i];
+		if (p >= 0) { viewChildren[p]++; }
+	}
+	if (order.size() > 0) {
+		viewBegin = order[0];
+	}
+
+}
+
+/* presents ancestors of lineages crossing slice, with crossing lineages cut back to slice */
+/* the stem above the first split is removed, as peelBack() would */
+void TreeView::timeSlice(double slice) {
+
+	invalidate();
+	sliced = true;
+	sliceTime = slice;
+	viewBegin = -1;
+
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		int p = effParent[i];
+		isCut[i] = p >= 0 && time[i] > slice && time[p] <= slice;
+		inView[i] = false;
+		viewChildren[i] = 0;
+		count[i] = 0;
+	}
+
+	/* count crossing lineages descended from each node, working from tips back */
+	for (int k = order.size() - 1; k >= 0; k--) {
+		int i = order[k];
+		int p = effParent[i];
+		if (isCut[i]) {
+			count[i] = 1;
+			viewChildren[i] = 0;
+		}
+		if (count[i] > 0 && p >= 0) {
+			count[p] += count[i];
+			viewChildren[p]++;
+			child[p] = i;
+		}
+	}
+
+	/* first top-level node with crossing lineages, and first split below it */
+	int b = -1;
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		if (effParent[i] < 0 && count[i] > 0) {
+			b = i;
+			break;
+		}
+	}
+	if (b < 0) { return; }
+
+	int m = b;
+	while (viewChildren[m] == 1) {
+		m = child[m];
+	}
+
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		if (count[i] > 0) {
+			int p = effParent[i];
+			inView[i] = true;
+			viewParent[i] = p;
+			viewTime[i] = time[i];
+			viewLength[i] = effLength[i];
+			if (isCut[i]) {
+				viewTime[i] = slice;
+				viewLength[i] = slice - time[p];
+			}
+			viewLeaf[i] = leaf[i] || isCut[i];
+			viewInclude[i] = include[i];
+		}
+	}
+
+	for (int i = b; i != m; i = child[i]) {
+		inView[i] = false;
+	}
+	if (m != b) {
+		viewParent[m] = -1;
+		viewLength[m] = 0.0;
+	}
+	viewBegin = m;
+
+}
+
+/* presents nodes between start and stop, as trimEnds() leaves them */
+/* lineages crossing stop are cut back to stop, and parents of lineages crossing start are */
+/* pushed up to start and become excluded top-level nodes */
+void TreeView::trimEnds(double start, double stop) {
+
+	invalidate();
+	sliced = false;
+	viewBegin = -1;
+	int firstMoved = -1;
+
+	/* nodes below a lineage crossing stop are erased */
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		int p = effParent[i];
+		bool gone = p >= 0 && (flag[p] || isCut[p]);
+		flag[i] = gone;
+		isCut[i] = !gone && p >= 0 && time[i] > stop && time[p] < stop;
+		viewTime[i] = time[i];
+		if (isCut[i]) { viewTime[i] = stop; }
+		viewChildren[i] = 0;
+		count[i] = 0;
+	}
+
+	/* count children reaching past start */
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		int p = effParent[i];
+		if (!flag[i] && p >= 0 && viewTime[i] > start) {
+			count[p]++;
+		}
+	}
+
+	/* nodes before start survive only if they have been pushed up to start */
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		int p = effParent[i];
+		bool moved = !flag[i] && time[i] < start && count[i] > 0;
+		inView[i] = !flag[i] && (moved || (time[i] >= start && (p < 0 || inView[p])));
+		if (inView[i]) {
+			viewParent[i] = p;
+			viewInclude[i] = include[i];
+			viewLeaf[i] = leaf[i] || isCut[i];
+			if (moved) {
+				viewParent[i] = -1;
+				viewTime[i] = start;
+				viewInclude[i] = false;
+			}
+			if (viewParent[i] >= 0) {
+				viewLength[i] = viewTime[i] - viewTime[viewParent[i]];
+				viewChildren[viewParent[i]]++;
+			}
+			else if (moved) {
+				viewLength[i] = 0.0;
+			}
+			else {
+				viewLength[i] = effLength[i];
+			}
+			if (moved && firstMoved < 0) { firstMoved = i; }
+		}
+	}
+
+	/* the original root stays at the head of the tree, moved nodes are placed after it */
+	if (order.size() > 0 && inView[order[0]]) { viewBegin = order[0]; }
+	else { viewBegin = firstMoved; }
+
+}
+
+/* presents tree with descendents of trunk at slice removed */
+void TreeView::trunkSlice(double slice) {
+
+	invalidate();
+	sliced = false;
+	viewBegin = -1;
+
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		int p = effParent[i];
+		bool gone = p >= 0 && (!inView[p] || isCut[p]);
+		isCut[i] = !gone && p >= 0 && time[i] > slice && time[p] <= slice && trunk[i] && trunk[p];
+		inView[i] = !gone;
+		viewChildren[i] = 0;
+		if (inView[i]) {
+			viewParent[i] = p;
+			viewTime[i] = time[i];
+			viewLength[i] = effLength[i];
+			if (isCut[i]) {
+				viewTime[i] = slice;
+				viewLength[i] = slice - time[p];
+			}
+			viewLeaf[i] = leaf[i] || isCut[i];
+			viewInclude[i] = include[i];
+			if (p >= 0) { viewChildren[p]++; }
+			if (viewBegin < 0) { viewBegin = i; }
+		}
+	}
+
+}
+
+/* gathers counts, times, lengths and tip sums for the whole view in a single pass */
+void TreeView::tally() {
+
+	int L = labelNames.size();
+	labelLength.assign(L, 0.0);
+	coalCounts.assign(L, 0);
+	migCounts.assign(L * L, 0);
+	tipCount = 0;
+	leafCount = 0;
+	coalTotal = 0;
+	migTotal = 0;
+	totalLength = 0.0;
+	rateSum = 0.0;
+	traitSums.assign(traits.size(), 0.0);
+
+	/* present and root time check the first node and every node without children */
+	presentTime = 0.0 / 0.0;
+	rootTime = 0.0 / 0.0;
+	if (viewBegin >= 0) {
+		presentTime = viewTime[viewBegin];
+		rootTime = viewTime[viewBegin];
+	}
+
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		if (!inView[i]) { continue; }
+		
+		if (viewChildren[i] == 0) {
+			tipCount++;
+			if (viewTime[i] > presentTime) { presentTime = viewTime[i]; }
+			if (viewTime[i] < rootTime) { rootTime = viewTime[i]; }
+			rateSum += rate[i];
+			for (int d = 0; d < traits.size(); d++) {
+				traitSums[d] += interpolate(traits[d], i);
+			}
+		}
+		if (viewLeaf[i]) {
+			leafCount++;
+		}
+		if (viewInclude[i]) {
+			totalLength += viewLength[i];
+			labelLength[label[i]] += viewLength[i];
+			if (viewChildren[i] == 2) {
+				coalTotal++;
+				coalCounts[label[i]]++;
+			}
+		}
+		
+		/* migration events are nodes in which the parent label differs from child label */
+		int p = viewParent[i];
+		if (p >= 0 && viewInclude[i] && viewInclude[p] && label[i] != label[p]) {
+			migTotal++;
+			migCounts[label[p] * L + label[i]]++;
+		}
+		
+	}
+
+	tallied = true;
+
+}
+
+/* most recent node in view, checking the first node and every leaf */
+double TreeView::getPresentTime() {
+	if (!tallied) { tally(); }
+	return presentTime;
+}
+
+/* most ancient node in view, checking the first node and every leaf */
+double TreeView::getRootTime() {
+	if (!tallied) { tally(); }
+	return rootTime;
+}
+
+/* amount of time it takes for all samples to coalesce */
+double TreeView::getTMRCA() {
+
+	if (!tallied) { tally(); }
+	
+	double tmrca = 0.0;
+	if (tipCount > 1) {
+		tmrca = presentTime - rootTime;
+	}
+	else {
+		tmrca /= tmrca;
+	}
+	return tmrca;
+
+}
+
+/* number of leaf nodes */
+int TreeView::getLeafCount() {
+	if (!tallied) { tally(); }
+	return leafCount;
+}
+
+/* total length of the view */
+double TreeView::getLength() {
+	if (!tallied) { tally(); }
+	return totalLength;
+}
+
+/* length of the view with label l */
+double TreeView::getLength(string l) {
+
+	if (!tallied) { tally(); }
+	int a = findLabel(l);
+	if (a < 0) { return 0.0; }
+	return labelLength[a];
+
+}
+
+/* get proportion of view with label */
+double TreeView::getLabelPro(string l) {
+	return getLength(l) / getLength();
+}
+
+/* returns the count of coalescent events */
+int TreeView::getCoalCount() {
+	if (!tallied) { tally(); }
+	return coalTotal;
+}
+
+/* returns the count of coalescent events with label */
+int TreeView::getCoalCount(string l) {
+
+	if (!tallied) { tally(); }
+	int a = findLabel(l);
+	if (a < 0) { return 0; }
+	return coalCounts[a];
+
+}
+
+/* steps through time as CoalescentTree::getCoalWeight does, but counts concurrent lineages */
+/* from sorted branch start and stop times rather than by visiting every node at every step */
+/* branches are bucketed by label, so that every label is weighed from a single sort */
+void TreeView::weigh() {
+
+	int L = labelNames.size();
+	labelWeight.assign(L, 0.0);
+	weightTotal = 0.0;
+	weighed = true;
+
+	// setting step to be 1/1000 of the total length of the tree
+	double start = getRootTime();
+	double stop = getPresentTime();
+	double step = (stop - start) / (double) 1000;
+	if (!(step > 0.0)) { return; }
+
+	/* a lineage is present at t if its parent is before t and it is not before t */
+	vector<int> offset (L + 1, 0);
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		int p = viewParent[i];
+		if (inView[i] && viewInclude[i] && p >= 0 && viewTime[p] < viewTime[i]) {
+			offset[label[i] + 1]++;
+		}
+	}
+	for (int a = 0; a < L; a++) {
+		offset[a + 1] += offset[a];
+	}
+	starts.resize(offset[L]);
+	stops.resize(offset[L]);
+	vector<int> fill (offset.begin(), offset.end() - 1);
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		int p = viewParent[i];
+		if (inView[i] && viewInclude[i] && p >= 0 && viewTime[p] < viewTime[i]) {
+			starts[fill[label[i]]] = viewTime[p];
+			stops[fill[label[i]]] = viewTime[i];
+			fill[label[i]]++;
+		}
+	}
+
+	for (int a = 0; a < L; a++) {
+		sort(starts.begin() + offset[a], starts.begin() + offset[a + 1]);
+		sort(stops.begin() + offset[a], stops.begin() + offset[a + 1]);
+		labelWeight[a] = sweep(offset[a], offset[a + 1], start, stop, step);
+	}
+	
+	sort(starts.begin(), starts.end());
+	sort(stops.begin(), stops.end());
+	weightTotal = sweep(0, starts.size(), start, stop, step);
+
+}
+
+/* accumulates pairs of concurrent lineages from sorted starts and stops between from and to */
+double TreeView::sweep(int from, int to, double start, double stop, double step) {
+
+	double weight = 0.0;
+	int begun = from;
+	int ended = from;
+	for (double t = start; t <= stop; t += step) {
+
+		while (begun < to && starts[begun] < t) { begun++; }
+		while (ended < to && stops[ended] < t) { ended++; }
+		int lineages = begun - ended;
+
+		if (lineages > 0) {
+			weight += ( ( lineages * (lineages - 1) ) / 2 ) * step;
+		}
+
+	}
+	return weight;
+
+}
+
+/* returns the opportunity for coalescence */
+double TreeView::getCoalWeight() {
+	if (!weighed) { weigh(); }
+	return weightTotal;
+}
+
+/* returns the opportunity for coalescence for label */
+double TreeView::getCoalWeight(string l) {
+
+	if (!weighed) { weigh(); }
+	int a = findLabel(l);
+	if (a < 0) { return 0.0; }
+	return labelWeight[a];
+
+}
+
+double TreeView::getCoalRate() {
+	return getCoalCount() / getCoalWeight();
+}
+
+double TreeView::getCoalRate(string l) {
+	return getCoalCount(l) / getCoalWeight(l);
+}
+
+/* returns the count of migration events, nodes in which the parent label differs from child label */
+int TreeView::getMigCount() {
+	if (!tallied) { tally(); }
+	return migTotal;
+}
+
+/* returns the count of migration events from label to label */
+int TreeView::getMigCount(string from, string to) {
+
+	if (!tallied) { tally(); }
+	int a = findLabel(from);
+	int b = findLabel(to);
+	if (a < 0 || b < 0) { return 0; }
+	return migCounts[a * labelNames.size() + b];
+
+}
+
+/* returns the overall rate of migration */
+double TreeView::getMigRate() {
+	return getMigCount() / getLength();
+}
+
+/* returns the rate of migration from label to label, see CoalescentTree::getMigRate */
+double TreeView::getMigRate(string from, string to) {
+	return getMigCount(from,to) / getLength(to);
+}
+
+/* tallies (2 * time to common ancestor) over pairs of included leaves, for all pairs and for */
+/* pairs sharing each label */
+/* rather than finding the common ancestor of every pair, each node tallies the pairs of leaves */
+/* that meet at it, along with the summed times of those leaves */
+void TreeView::diversify() {
+
+	int n = parent.size();
+	int L = labelNames.size();
+
+	/* per node: leaf count, leaf time sum, and the same two sums over children, */
+	/* followed by these four for each label */
+	int width = 4 + 4 * L;
+	sum.assign(n * width, 0.0);
+	labelDiv.assign(L, 0.0);
+	labelPairs.assign(L, 0.0);
+	divTotal = 0.0;
+	pairsTotal = 0.0;
+
+	double ref = 0.0;
+	if (viewBegin >= 0) { ref = viewTime[viewBegin]; }
+
+	for (int k = order.size() - 1; k >= 0; k--) {
+		int i = order[k];
+		if (!inView[i]) { continue; }
+		double *s = &sum[i * width];
+		double t = viewTime[i] - ref;
+
+		if (viewChildren[i] == 0) {
+			if (viewInclude[i]) {
+				s[0] = 1.0;
+				s[1] = t;
+				s[4 + 4 * label[i]] = 1.0;
+				s[5 + 4 * label[i]] = t;
+			}
+		}
+		else {
+			/* pairs meeting here are all pairs below, less those meeting in a child */
+			double np = (s[0] * s[0] - s[2]) / 2.0;
+			pairsTotal += np;
+			divTotal += (s[1] * s[0] - s[3]) - 2.0 * t * np;
+			for (int a = 0; a < L; a++) {
+				double *ls = &s[4 + 4 * a];
+				if (ls[0] > 0.0) {
+					double wp = (ls[0] * ls[0] - ls[2]) / 2.0;
+					labelPairs[a] += wp;
+					labelDiv[a] += (ls[1] * ls[0] - ls[3]) - 2.0 * t * wp;
+				}
+			}
+		}
+
+		int p = viewParent[i];
+		if (p >= 0) {
+			double *ps = &sum[p * width];
+			ps[0] += s[0];
+			ps[1] += s[1];
+			ps[2] += s[0] * s[0];
+			ps[3] += s[1] * s[0];
+			for (int a = 0; a < L; a++) {
+				double *ls = &s[4 + 4 * a];
+				if (ls[0] > 0.0) {
+					double *pls = &ps[4 + 4 * a];
+					pls[0] += ls[0];
+					pls[1] += ls[1];
+					pls[2] += ls[0] * ls[0];
+					pls[3] += ls[1] * ls[0];
+				}
+			}
+		}
+
+	}
+
+	diversified = true;
+
+}
+
+/* return mean of (2 * time to common ancestor) for every pair of leaf nodes */
+double TreeView::getDiversity() {
+	if (!diversified) { diversify(); }
+	return divTotal / pairsTotal;
+}
+
+/* diversity where both samples have label l */
+double TreeView::getDiversity(string l) {
+
+	if (!diversified) { diversify(); }
+	int a = findLabel(l);
+	if (a < 0) { return 0.0 / 0.0; }
+	return labelDiv[a] / labelPairs[a];
+
+}
+
+double TreeView::getDiversityWithin() {
+
+	if (!diversified) { diversify(); }
+	double div = 0.0;
+	double pairs = 0.0;
+	for (int a = 0; a < labelNames.size(); a++) {
+		div += labelDiv[a];
+		pairs += labelPairs[a];
+	}
+	return div / pairs;
+
+}
+
+double TreeView::getDiversityBetween() {
+
+	if (!diversified) { diversify(); }
+	double div = divTotal;
+	double pairs = pairsTotal;
+	for (int a = 0; a < labelNames.size(); a++) {
+		div -= labelDiv[a];
+		pairs -= labelPairs[a];
+	}
+	return div / pairs;
+
+}
+
+/* returns population subdivision Fst = (divBetween - divWithin) / divBetween */
+double TreeView::getFst() {
+
+	double divWithin = getDiversityWithin();
+	double divBetween = getDiversityBetween();
+	double fst = (divBetween - divWithin) / divBetween;
+	return fst;
+
+}
+
+/* return D = pi - S/a1, where pi is diversity, S is the total tree length, and a1 is a normalization factor */
+double TreeView::getTajimaD() {
+
+	double div = getDiversity();
+	double S = getLength();
+
+	double a1 = 0.0;
+	double a2 = 0.0;
+	int n = getLeafCount();
+	for (int i = 1; i < n; i++) {
+		a1 += 1 / (double) i;
+		a2 += 1 / (double) (i*i);
+	}
+
+	double e1 = (1.0/a1) * ((double)(n+1) / (3*(n-1)) - (1.0/a1));
+	double e2 = (1.0 / (a1*a1 + a2) ) * ( (double)(2*(n*n+n+3)) / (9*n*(n-1)) - (double)(n+2) / (n*a1) + a2/(a1*a1) );
+	double denom = sqrt(e1*S + e2*S*(S-1));
+	double tajima = (div - S/a1) / denom;
+
+	return tajima;
+
+}
+
+/* finds time from each tip back to its first ancestor with a different label */
+/* rather than walking back from every tip, each node inherits its parent's nearest ancestor with */
+/* a different label whenever the two share a label, so a single preorder pass suffices */
+void TreeView::persist() {
+
+	int L = labelNames.size();
+	labelPersist.assign(L, 0.0);
+	labelPersistCount.assign(L, 0);
+	labelPersistSeries.assign(L, Series());
+	persistAll.clear();
+	persistTotal = 0.0;
+	persistCount = 0;
+
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		if (!inView[i]) { continue; }
+		
+		int p = viewParent[i];
+		count[i] = -1;
+		if (p >= 0) {
+			if (label[p] != label[i]) { count[i] = p; }
+			else { count[i] = count[p]; }
+		}
+		
+		if (viewChildren[i] == 0 && count[i] >= 0) {
+			double t = viewTime[i] - viewTime[count[i]];
+			persistTotal += t;
+			persistCount++;
+			persistAll.insert(t);
+			labelPersist[label[i]] += t;
+			labelPersistCount[label[i]]++;
+			labelPersistSeries[label[i]].insert(t);
+		}
+		
+	}
+
+	persisted = true;
+
+}
+
+/* mean time from tip back to first change of label, over tips that have changed label */
+double TreeView::getPersistence() {
+	if (!persisted) { persist(); }
+	return persistTotal / (double) persistCount;
+}
+
+double TreeView::getPersistence(string l) {
+
+	if (!persisted) { persist(); }
+	int a = findLabel(l);
+	if (a < 0) { return 0.0 / 0.0; }
+	return labelPersist[a] / (double) labelPersistCount[a];
+
+}
+
+double TreeView::getPersistenceQuantile(double q) {
+	if (!persisted) { persist(); }
+	return persistAll.quantile(q);
+}
+
+double TreeView::getPersistenceQuantile(double q, string l) {
+
+	if (!persisted) { persist(); }
+	int a = findLabel(l);
+	if (a < 0) { return 0.0 / 0.0; }
+	return labelPersistSeries[a].quantile(q);
+
+}
+
+/* return mean X location across all tips in view */
+double TreeView::getMeanX() {
+	if (!tallied) { tally(); }
+	return traitSums[0] / (double) tipCount;
+}
+
+/* return mean Y location across all tips in view */
+double TreeView::getMeanY() {
+	if (!tallied) { tally(); }
+	return traitSums[1] / (double) tipCount;
+}
+
+/* return mean of a trait dimension across all tips in view, zero for dimensions the tree lacks */
+double TreeView::getMeanTrait(int k) {
+	if (!tallied) { tally(); }
+	if (k >= traitSums.size()) { return 0.0 / (double) tipCount; }
+	return traitSums[k] / (double) tipCount;
+}
+
+/* return mean rate across all tips in view */
+double TreeView::getMeanRate() {
+	if (!tallied) { tally(); }
+	return rateSum / (double) tipCount;
+}
+
+vector<double> TreeView::getTipsX() {
+
+	vector<double> tiplocs;
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		if (inView[i] && viewChildren[i] == 0) {
+			tiplocs.push_back( interpolate(traits[0], i) );
+		}
+	}
+	return tiplocs;
+
+}
+
+vector<double> TreeView::getTipsY() {
+
+	vector<double> tiplocs;
+	for (int k = 0; k < order.size(); k++) {
+		int i = order[k];
+		if (inView[i] && viewChildren[i] == 0) {
+			tiplocs.push_back( interpolate(traits[1], i) );
+		}
+	}
+	return tiplocs;
+
+}
+
+/* a tip is matched by name among leaf nodes, as getNameMask selects it */
+void TreeView::tracePaths(vector<string> &names) {
+
+	int n = nodes.size();
+	pathNames = names;
+	paths.assign(names.size(), vector<int>());
+	pathTraced.assign(names.size(), true);
+
+	/* a name listed more than once shares the matches of its first listing */
+	map<string,int> wanted;
+	for (int k = names.size() - 1; k >= 0; k--) {
+		wanted[names[k]] = k;
+	}
+	vector<int> matches (names.size(), 0);
+	vector<int> tip (names.size(), -1);
+	for (int i = 0; i < n; i++) {
+		if (!leaf[i]) { continue; }
+		map<string,int>::iterator wt = wanted.find( (*nodes[i]).getName() );
+		if (wt != wanted.end()) {
+			matches[wt->second]++;
+			tip[wt->second] = i;
+		}
+	}
+
+	for (int k = 0; k < names.size(); k++) {
+		int first = wanted[names[k]];
+		if (matches[first] > 1) {
+			pathTraced[k] = false;
+			continue;
+		}
+		if (matches[first] == 0) {
+			continue;
+		}
+		vector<int> &path = paths[k];
+		for (int i = tip[first]; i >= 0; i = parent[i]) {
+			path.push_back(i);
+		}
+		reverse(path.begin(), path.end());
+		for (int j = 1; j < path.size(); j++) {
+			if (time[path[j]] < time[path[j-1]]) {
+				pathTraced[k] = false;
+			}
+		}
+	}
+
+}
+
+/* along a single lineage with rising times, the most recent node is the tip */
+double TreeView::getPathPresentTime(int k) {
+
+	if (!pathTraced[k]) {
+		attach(*source);
+		pruneToName(pathNames[k]);
+		return getPresentTime();
+	}
+	if (paths[k].size() == 0) {
+		return 0.0 / 0.0;
+	}
+	return time[paths[k].back()];
+
+}
+
+/* the slice cuts the single branch crossing it, which is the only tip left in view */
+/* times outside the path, or at the tip itself, leave nothing in view and give NaN */
+void TreeView::slicePath(int k, vector<double> &times, vector<double> &xs, vector<double> &ys) {
+
+	xs.assign(times.size(), 0.0 / 0.0);
+	ys.assign(times.size(), 0.0 / 0.0);
+
+	if (!pathTraced[k]) {
+		attach(*source);
+		pruneToName(pathNames[k]);
+		for (int j = 0; j < times.size(); j++) {
+			timeSlice(times[j]);
+			xs[j] = getMeanX();
+			ys[j] = getMeanY();
+		}
+		return;
+	}
+
+	vector<int> &path = paths[k];
+	vector<double> &xloc = traits[0];
+	vector<double> &yloc = traits[1];
+	int c = 1;
+	for (int j = 0; j < times.size(); j++) {
+		double t = times[j];
+		if (j > 0 && t < times[j-1]) { c = 1; }
+		while (c < path.size() && time[path[c]] <= t) { c++; }
+		if (c >= path.size() || time[path[c-1]] > t) { continue; }
+		
+		/* interpolated as interpolate() would, and summed as tally() would */
+		int i = path[c];
+		int p = path[c-1];
+		double timediff = time[i] - time[p];
+		xs[j] = 0.0 + (xloc[p] + (t - time[p]) * ((xloc[i] - xloc[p]) / timediff));
+		ys[j] = 0.0 + (yloc[p] + (t - time[p]) * ((yloc[i] - yloc[p]) / timediff));
+	}
+
+}
+
+void TreeView::invalidate() {
+	tallied = false;
+	weighed = false;
+	diversified = false;
+	persisted = false;
+}
+
+int TreeView::addLabel(string l) {
+
+	map<string,int>::iterator lt = labelIndex.find(l);
+	if (lt == labelIndex.end()) {
+		labelIndex[l] = labelNames.size();
+		labelNames.push_back(l);
+		return labelNames.size() - 1;
+	}
+	return lt->second;
+
+}
+
+int TreeView::findLabel(string l) {
+
+	map<string,int>::iterator lt = labelIndex.find(l);
+	if (lt == labelIndex.end()) {
+		return -1;
+	}
+	return lt->second;
+
+}
+
+/* value of a trait for node i, interpolated along its branch if the node was cut by a time slice */
+double TreeView::interpolate(vector<double> &v, int i) {
+
+	if (!sliced || !isCut[i]) {
+		return v[i];
+	}
+	int p = effParent[i];
+	double diff = v[i] - v[p];
+	double timediff = time[i] - time[p];
+	double ratediff = diff / timediff;
+	return v[p] + (sliceTime - time[p]) * ratediff;
+
+}
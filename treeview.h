@@ -0,0 +1,217 @@
+/* treeview.h
+Copyright 2009-2013 Trevor Bedford <t.bedford@ed.ac.uk>
+TreeView class definition
+This object presents a CoalescentTree as if it had been pruned, sliced or trimmed, without copying or
+modifying the underlying tree.  Nodes are flattened into arrays in preorder when a tree is attached, and
+cuts in time are computed on the fly, so that a single TreeView can be reused across trees and time bins.
+*/
+
+/*
+This file is part of PACT.
+
+PACT is free software: you can redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PACT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along with PACT.  If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TVIEW_H
+#define TVIEW_H
+
+#include <map>
+using std::map;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "tree.hh"
+#include "node.h"
+#include "coaltree.h"
+#include "mask.h"
+#include "series.h"
+
+class TreeView {
+
+public:
+	TreeView();								// constructor
+
+	void attach(CoalescentTree &);			// flattens tree into view, presenting the whole tree
+											// buffers are reused from one tree to the next
+	void relabel();							// rereads labels after the attached tree selects another
+											// discrete trait, presenting the whole tree
+
+	// RESTRICTIONS
+	// these last until the next attach, and are applied before any cut
+	void pruneToMask(Mask);					// presents tree as CoalescentTree::pruneToMask would leave it
+	void pruneToTrunk();					// presents tree as CoalescentTree::pruneToTrunk would leave it
+	void pruneToName(string);				// presents tree as CoalescentTree::pruneToName would leave it
+
+	// CUTS
+	// each cut replaces the previous one
+	void whole();							// presents the whole (restricted) tree
+	void timeSlice(double);					// presents tree as CoalescentTree::timeSlice would leave it,
+											// interpolating locations at the slice
+	void trimEnds(double,double);			// presents tree as CoalescentTree::trimEnds would leave it
+	void trunkSlice(double);				// presents tree as CoalescentTree::trunkSlice would leave it
+
+	// BASIC STATISTICS
+	double getPresentTime();				// returns most recent time in view
+	double getRootTime();					// returns most ancient time in view
+	double getTMRCA();						// span of time in view
+	int getLeafCount();						// returns the count of leaf nodes in view
+
+	// LABEL STATISTICS
+	double getLength();						// return total length of view
+	double getLength(string);				// return length with this label
+	double getLabelPro(string);				// return proportion of view with label
+
+	// COALESCENT STATISTICS
+	int getCoalCount();						// count of coalescent events
+	int getCoalCount(string);				// count of coalescent events involving label
+	double getCoalWeight();					// opportunity for coalescence
+	double getCoalWeight(string);			// opportunity for coalescence involving label
+	double getCoalRate();
+	double getCoalRate(string);
+
+	// MIGRATION STATISTICS
+	int getMigCount();
+	int getMigCount(string,string);
+	double getMigRate();
+	double getMigRate(string,string);
+
+	// DIVERSITY STATISTICS
+	double getDiversity();					// return mean of (2 * time to common ancestor) for every pair of leaf nodes
+	double getDiversity(string);			// diversity where both samples have label
+	double getDiversityWithin();			// diversity where both samples have the same label
+	double getDiversityBetween();			// diversity where both samples have different labels
+	double getFst();						// Fst = (divBetween - divWithin) / divBetween
+	double getTajimaD();					// return D = pi - S/a1, as in CoalescentTree
+
+	// PERSISTENCE STATISTICS
+	double getPersistence();				// mean time from each tip back to its first change of label
+	double getPersistence(string);			// persistence of tips with label
+	double getPersistenceQuantile(double);
+	double getPersistenceQuantile(double,string);
+
+	// LOCATION AND RATE STATISTICS
+	double getMeanX();						// return mean X location across all tips in view
+	double getMeanY();						// return mean Y location across all tips in view
+	double getMeanTrait(int);				// return mean of trait dimension across all tips in view
+	double getMeanRate();					// return mean rate across all tips in view
+	vector<double> getTipsX();				// returns a vector of double for X position of every tip in view
+	vector<double> getTipsY();				// returns a vector of double for Y position of every tip in view
+
+	// ANCESTRAL PATHS
+	// paths are read from the whole attached tree, so these are called straight after attach
+	void tracePaths(vector<string> &);		// finds the path from the top of the tree to each named tip
+	double getPathPresentTime(int);			// present time of path, as pruneToName would leave it
+	void slicePath(int, vector<double> &, vector<double> &, vector<double> &);	// x and y at each of a 
+											// rising series of times, as pruneToName and timeSlice would leave them
+
+private:
+	// ATTACHED TREE, indexed in preorder
+	CoalescentTree *source;					// supplies cached masks
+	vector<tree<Node>::iterator> nodes;
+	vector<int> parent;						// index of parent, -1 at top level
+	vector<double> time;
+	vector<double> length;
+	vector< vector<double> > traits;		// one column per trait dimension, x and y first
+	vector<double> rate;
+	vector<int> label;						// index into labelNames
+	vector<char> leaf;
+	vector<char> trunk;
+	vector<char> include;
+	vector<string> labelNames;				// labels are interned once and shared across attached trees
+	map<string,int> labelIndex;
+
+	// RESTRICTED TREE
+	vector<int> order;						// nodes surviving restrictions, in preorder
+	vector<int> effParent;					// parent after restrictions, -1 at top level
+	vector<double> effLength;				// length after restrictions, merged nodes pass length to children
+
+	// PRESENTED TREE, after cut
+	vector<char> inView;
+	vector<char> isCut;						// node was cut back to the slice or window
+	vector<int> viewParent;
+	vector<double> viewTime;
+	vector<double> viewLength;
+	vector<char> viewLeaf;
+	vector<char> viewInclude;
+	vector<int> viewChildren;
+	double sliceTime;						// time of last slice, used to interpolate locations of cut nodes
+	bool sliced;
+	int viewBegin;							// node that CoalescentTree would return from nodetree.begin()
+
+	// TALLIES
+	// statistics are gathered together in as few passes as possible, each group on first use after a cut
+	bool tallied;							// counts, times, lengths and tip sums, in a single pass
+	int tipCount;							// nodes without children in view
+	int leafCount;							// leaf nodes in view
+	double presentTime;
+	double rootTime;
+	double totalLength;
+	vector<double> labelLength;
+	int coalTotal;
+	vector<int> coalCounts;
+	int migTotal;
+	vector<int> migCounts;					// L x L, indexed [from * L + to]
+	double rateSum;
+	vector<double> traitSums;				// one per trait dimension
+	
+	bool weighed;							// opportunity for coalescence, overall and for every label
+	double weightTotal;
+	vector<double> labelWeight;
+	
+	bool diversified;						// pairwise diversity, overall and within every label
+	double divTotal;
+	double pairsTotal;
+	vector<double> labelDiv;
+	vector<double> labelPairs;
+	
+	bool persisted;							// persistence of every tip, grouped by label
+	double persistTotal;
+	int persistCount;
+	Series persistAll;
+	vector<double> labelPersist;
+	vector<int> labelPersistCount;
+	vector<Series> labelPersistSeries;
+
+	// PATHS
+	vector<string> pathNames;
+	vector< vector<int> > paths;			// nodes from top to tip, in preorder
+	vector<char> pathTraced;				// path is a single lineage with rising times, otherwise the
+											// view is restricted and sliced as before
+
+	// SCRATCH
+	vector<int> count;
+	vector<int> child;
+	vector<char> flag;
+	vector<double> sum;
+	vector<double> starts;
+	vector<double> stops;
+
+	// HELPER FUNCTIONS
+	int findLabel(string);					// returns label index, -1 if label never seen
+	int addLabel(string);					// returns label index, interning label if never seen
+	void markMasked(Mask);					// flags selected tips and their ancestors
+	void restrict(bool);					// restricts view to nodes marked in flag, optionally merging as reduce() would
+	double interpolate(vector<double> &, int);	// value at slice for a cut node
+	void invalidate();						// marks all tallies as stale, called by every cut
+	void tally();
+	void weigh();
+	double sweep(int,int,double,double,double);	// coalescence weight over sorted starts and stops in range
+	void diversify();
+	void persist();
+
+};
+
+#endif